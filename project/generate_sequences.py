@@ -3,11 +3,14 @@ from random import choice
 import sys
 
 """
-Usage: python generate_sequences.py <length> 
+Usage: python generate_sequences.py <length> [<n_pairs>]
 
 This will create a .csv file named sequences_L<length>.csv with a single row and 2 columns, each column 
 containing a sequence of length <length>. 
 
+If <n_pairs> is given, a batch file named pairs_L<length>_N<n_pairs>.csv will be created instead,
+containing <n_pairs> rows, one pair of sequences per row.
+
 The .csv file will be created under the data/ directory.
 """
 
@@ -21,6 +24,12 @@ def generate_data_set(length):
   file_name = f'data/sequences_L{length}.csv'
   with open(file_name, 'w') as file:
     file.write(f'{generate_sequence(length)},{generate_sequence(length)}\n')
+
+def generate_batch_data_set(length, n_pairs):
+  file_name = f'data/pairs_L{length}_N{n_pairs}.csv'
+  with open(file_name, 'w') as file:
+    for i in range(n_pairs):
+      file.write(f'{generate_sequence(length)},{generate_sequence(length)}\n')
     
 
 def main():
@@ -31,7 +40,10 @@ def main():
 
     length = int(argv[1])
     
-    generate_data_set(length)
+    if argc > 2:
+      generate_batch_data_set(length, int(argv[2]))
+    else:
+      generate_data_set(length)
   
 if __name__ == "__main__":
   main()
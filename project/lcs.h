@@ -4,18 +4,84 @@
 
 #include "timer.h"
 #include <algorithm> // std::max
+#include <fcntl.h>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Non-owning view of a sequence of characters, along the lines of C++17's
+ * std::string_view (the code is built as C++14). The characters must outlive
+ * the view.
+ */
+class SequenceView
+{
+protected:
+  const char *chars = nullptr;
+  size_t n_chars = 0;
+
+public:
+  SequenceView() {}
+
+  SequenceView(const char *chars, size_t n_chars)
+      : chars(chars), n_chars(n_chars)
+  {
+  }
+
+  /* Explicit, so that a view of a temporary string is never made by
+  accident. */
+  explicit SequenceView(const std::string &sequence)
+      : chars(sequence.data()), n_chars(sequence.length())
+  {
+  }
+
+  const char *data() const { return chars; }
+  size_t length() const { return n_chars; }
+  size_t size() const { return n_chars; }
+  bool empty() const { return n_chars == 0; }
+  const char *begin() const { return chars; }
+  const char *end() const { return chars + n_chars; }
+
+  const char &operator[](size_t index) const
+  {
+    return chars[index];
+  }
+
+  /* Returns a view of up to `count` characters starting at `pos`. */
+  SequenceView substr(size_t pos, size_t count = std::string::npos) const
+  {
+    pos = std::min(pos, n_chars);
+    return SequenceView(chars + pos, std::min(count, n_chars - pos));
+  }
+
+  std::string str() const
+  {
+    return std::string(chars, n_chars);
+  }
+};
+
+std::ostream &operator<<(std::ostream &out, const SequenceView &sequence)
+{
+  return out.write(sequence.data(), sequence.length());
+}
 
 /** Abstract Base class for LCS implementations */
 class LongestCommonSubsequence
 {
 protected:
-  const std::string sequence_a;
-  std::string sequence_b;
+  /* Copies of the sequences, when the solver is given strings. When it is
+  given views instead, these are empty, and the views point into memory owned
+  by the caller, such as a memory-mapped input file (see MappedInput). */
+  const std::string owned_a;
+  const std::string owned_b;
+  const SequenceView sequence_a;
+  const SequenceView sequence_b;
   const int length_a; // Length of sequence_a.
   int length_b;       // Length of sequence_b.
   int max_length;     /* The longest common subsequence cannot be longer
@@ -133,15 +199,84 @@ protected:
     }
   }
 
+  /* Used to split the backtrace into segments that can be traced
+  independently. For every cell of `row` in columns start_col..end_col, records
+  the row at which the backtrace starting from that cell first reaches column
+  start_col - 1, or 0 if it reaches the top row first. Entry k of each array
+  corresponds to column start_col - 1 + k, and `previous_exits` holds the
+  entries of the row above (all 0 for the top row). */
+  void computeTraceExits(const int row, const int start_col, const int end_col,
+                         const int *previous_exits, int *exits)
+  {
+    const int *current_row = matrix[row] + start_col - 1;
+    const int *top_row = matrix[row - 1] + start_col - 1;
+    int left_exit = row;
+    exits[0] = left_exit;
+    for (int k = 1; k <= end_col - start_col + 1; k++)
+    {
+      int current = current_row[k];
+      int top_left = top_row[k - 1];
+      int top = top_row[k];
+      int left = current_row[k - 1];
+
+      // Same choice of step as determineLongestCommonSubsequence(). The
+      // choice is unpredictable, so it is made with masks rather than
+      // branches.
+      int go_top_left = -((top_left == current) | ((top_left == top) & (top_left == left)));
+      int go_up = go_top_left | -(top == current);
+      int vertical_exit = (previous_exits[k - 1] & go_top_left) | (previous_exits[k] & ~go_top_left);
+      left_exit = (vertical_exit & go_up) | (left_exit & ~go_up);
+      exits[k] = left_exit;
+    }
+  }
+
+  /* Traces the part of the backtrace that enters columns start_col..end_col
+  at (row, end_col), up to where it leaves them. Appends the characters of
+  the longest common subsequence found on the way to `segment`, in order, and
+  returns the row at which the trace reached column start_col - 1. */
+  int traceSegment(int row, const int start_col, const int end_col,
+                   std::string &segment)
+  {
+    size_t first = segment.length();
+    int col = end_col;
+    while (row > 0 && col >= start_col)
+    {
+      int current = matrix[row][col];
+      int top_left = matrix[row - 1][col - 1];
+      int top = matrix[row - 1][col];
+      int left = matrix[row][col - 1];
+
+      if (top_left == current)
+      {
+        row--;
+        col--;
+      }
+      else if (top_left == top && top_left == left)
+      {
+        segment.push_back(sequence_a[row - 1]);
+        row--;
+        col--;
+      }
+      else if (top == current)
+      {
+        row--;
+      }
+      else
+      {
+        col--;
+      }
+    }
+    // The characters were found from last to first.
+    std::reverse(segment.begin() + first, segment.end());
+    return row;
+  }
+
   virtual void
   solve() = 0;
 
-public:
-  LongestCommonSubsequence(const std::string &sequence_a, const std::string &sequence_b)
-      : sequence_a(sequence_a), sequence_b(sequence_b),
-        length_a(sequence_a.length()), length_b(sequence_b.length()),
-        max_length(std::min(length_a, length_b)),
-        matrix_width(length_b + 1), matrix_height(length_a + 1)
+  /* Allocates the matrix, with its top row and leftmost column filled with
+  0s. */
+  void allocateMatrix()
   {
     matrix = new int *[matrix_height];
     for (int i = 0; i < matrix_height; i++)
@@ -157,8 +292,48 @@ public:
     }
   }
 
+public:
+  /* Implementations that only compute the length of the longest common
+  subsequence can pass `allocate_matrix = false` to avoid allocating the full
+  matrix. `matrix` is then null, and they must override
+  getLongestSubsequenceLength(). */
+  LongestCommonSubsequence(const std::string &sequence_a, const std::string &sequence_b,
+                           bool allocate_matrix = true)
+      : owned_a(sequence_a), owned_b(sequence_b),
+        sequence_a(owned_a), sequence_b(owned_b),
+        length_a(sequence_a.length()), length_b(sequence_b.length()),
+        max_length(std::min(length_a, length_b)),
+        matrix_width(length_b + 1), matrix_height(length_a + 1),
+        matrix(nullptr)
+  {
+    if (allocate_matrix)
+    {
+      allocateMatrix();
+    }
+  }
+
+  /* Solves views of the sequences in place, without copying them. The
+  characters must outlive the solver. */
+  LongestCommonSubsequence(const SequenceView &sequence_a, const SequenceView &sequence_b,
+                           bool allocate_matrix = true)
+      : sequence_a(sequence_a), sequence_b(sequence_b),
+        length_a(sequence_a.length()), length_b(sequence_b.length()),
+        max_length(std::min(length_a, length_b)),
+        matrix_width(length_b + 1), matrix_height(length_a + 1),
+        matrix(nullptr)
+  {
+    if (allocate_matrix)
+    {
+      allocateMatrix();
+    }
+  }
+
   virtual ~LongestCommonSubsequence()
   {
+    if (matrix == nullptr)
+    {
+      return;
+    }
     for (int row = 0; row < matrix_height; row++)
     {
       delete[] matrix[row];
@@ -172,6 +347,12 @@ public:
     return matrix[matrix_height - 1][matrix_width - 1];
   }
 
+  // Returns the longest common subsequence found by the backtrace.
+  const std::string &getLongestCommonSubsequence() const
+  {
+    return longest_common_subsequence;
+  }
+
   // Print the matrix to the console.
   void printMatrix()
   {
@@ -269,7 +450,148 @@ public:
   }
 };
 
+/* Returns the length of `data` without the line breaks at its end. Every
+input reader drops them from sequence_b, so that a file ending in a newline
+gives the same sequences whichever way it is read. */
+size_t trim_line_break(const char *data, size_t length)
+{
+  while (length > 0 && (data[length - 1] == '\n' || data[length - 1] == '\r'))
+  {
+    length--;
+  }
+  return length;
+}
+
+/* Reads the two sequences from a .csv file. Returns false, without printing
+anything, if the file cannot be opened. */
+bool load_input_csv(const std::string &input_file_path, std::string &sequence_a, std::string &sequence_b)
+{
+  std::ifstream in_file(input_file_path);
+  if (!in_file.is_open())
+  {
+    return false;
+  }
+  std::getline(in_file, sequence_a, ',');
+  std::getline(in_file, sequence_b, ',');
+  sequence_b.resize(trim_line_break(sequence_b.data(), sequence_b.length()));
+  return true;
+}
+
 void read_input_csv(const std::string &input_file_path, std::string &sequence_a, std::string &sequence_b)
+{
+  if (!load_input_csv(input_file_path, sequence_a, sequence_b))
+  {
+    std::cerr << "Error reading file: " << input_file_path << std::endl;
+    exit(1);
+  }
+}
+
+/**
+ * An input .csv file mapped into memory with mmap, with views of the two
+ * sequences in it. A solver given the views reads the sequences straight
+ * from the mapping, so they are never copied into strings, and the file's
+ * pages are only loaded as they are first used. The views are only valid for
+ * as long as the MappedInput exists.
+ */
+class MappedInput
+{
+protected:
+  void *address = MAP_FAILED;
+  size_t file_size = 0;
+
+  void unmap()
+  {
+    if (address != MAP_FAILED)
+    {
+      munmap(address, file_size);
+      address = MAP_FAILED;
+    }
+  }
+
+public:
+  SequenceView sequence_a;
+  SequenceView sequence_b;
+
+  MappedInput() {}
+  MappedInput(const MappedInput &) = delete;
+  MappedInput &operator=(const MappedInput &) = delete;
+
+  virtual ~MappedInput()
+  {
+    unmap();
+  }
+
+  /* Maps the file and finds the sequences in it: the first runs up to the
+  first comma, and the second from there up to the next comma or the end of
+  the file, without the trailing line break. Returns false, without printing
+  anything, if the file cannot be mapped. */
+  bool map(const std::string &input_file_path)
+  {
+    unmap();
+    sequence_a = sequence_b = SequenceView();
+    int fd = open(input_file_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+      close(fd);
+      return false;
+    }
+    file_size = file_stat.st_size;
+    if (file_size == 0)
+    {
+      close(fd);
+      return true; // Both sequences are empty.
+    }
+    address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open.
+    if (address == MAP_FAILED)
+    {
+      return false;
+    }
+    // Start reading the file in ahead of use.
+    madvise(address, file_size, MADV_WILLNEED);
+
+    SequenceView file((const char *)address, file_size);
+    const char *comma_a = (const char *)memchr(file.data(), ',', file.length());
+    if (comma_a == nullptr)
+    {
+      sequence_a = file;
+      return true;
+    }
+    sequence_a = SequenceView(file.data(), comma_a - file.data());
+    SequenceView rest = file.substr(sequence_a.length() + 1);
+    const char *comma_b = (const char *)memchr(rest.data(), ',', rest.length());
+    size_t length_b = comma_b != nullptr ? comma_b - rest.data() : rest.length();
+    length_b = trim_line_break(rest.data(), length_b);
+    sequence_b = rest.substr(0, length_b);
+    return true;
+  }
+};
+
+void map_input_csv(const std::string &input_file_path, MappedInput &input)
+{
+  if (!input.map(input_file_path))
+  {
+    std::cerr << "Error reading file: " << input_file_path << std::endl;
+    exit(1);
+  }
+}
+
+/* A single pair of input sequences, as read from one line of a batch file. */
+struct SequencePair
+{
+  std::string sequence_a;
+  std::string sequence_b;
+};
+
+/* Reads a batch file containing one pair of sequences per line, in the same
+`<sequence_a>,<sequence_b>` format as the single pair .csv files. Empty lines
+are skipped. */
+void read_input_pairs_csv(const std::string &input_file_path, std::vector<SequencePair> &pairs)
 {
   std::ifstream in_file(input_file_path);
   if (!in_file.is_open())
@@ -277,8 +599,29 @@ void read_input_csv(const std::string &input_file_path, std::string &sequence_a,
     std::cerr << "Error reading file: " << input_file_path << std::endl;
     exit(1);
   }
-  std::getline(in_file, sequence_a, ',');
-  std::getline(in_file, sequence_b, ',');
+  std::string line;
+  int line_number = 0;
+  while (std::getline(in_file, line))
+  {
+    line_number++;
+    // Strip trailing carriage returns and commas.
+    while (!line.empty() && (line.back() == '\r' || line.back() == ','))
+    {
+      line.pop_back();
+    }
+    if (line.empty())
+    {
+      continue;
+    }
+    size_t comma = line.find(',');
+    if (comma == std::string::npos || comma == 0 || comma == line.length() - 1)
+    {
+      std::cerr << "Error: malformed pair on line " << line_number
+                << " of " << input_file_path << std::endl;
+      exit(1);
+    }
+    pairs.push_back({line.substr(0, comma), line.substr(comma + 1)});
+  }
 }
 
 #endif
@@ -0,0 +1,309 @@
+#ifndef _LCS_BATCH_H_
+#define _LCS_BATCH_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lcs.h"
+#include "lcs_solver.h"
+#include "timer.h"
+
+/**
+ * Solves a large number of independent sequence pairs concurrently.
+ *
+ * Rather than splitting the matrix of a single pair between threads, each
+ * thread solves whole pairs on its own. Pairs are handed out dynamically
+ * through a shared atomic counter, so a thread that draws short pairs simply
+ * goes back for more work instead of waiting on the others. Results are
+ * stored by input index, so they come out in the same order as the input
+ * regardless of which thread solved which pair.
+ *
+ * When `simd_lanes` is set, the batch is instead solved with an
+ * inter-sequence kernel: pairs are sorted by length and packed into groups of
+ * `simd_lanes` pairs, and each group is computed in a single pass over the
+ * matrix with one pair per vector lane. Only the lengths are computed in this
+ * mode, or whenever `length_only` is set.
+ */
+class LongestCommonSubsequenceBatch
+{
+protected:
+  const std::vector<SequencePair> &pairs; // Input pairs, owned by the caller.
+  int numThreads;                         // Number of worker threads.
+  int simd_lanes;                         // Pairs per group, or 0 for scalar.
+  bool length_only;                       // Skip the subsequences.
+
+  /* Indices of the pairs sorted by length, used to group pairs of similar
+  length together in SIMD mode. */
+  std::vector<size_t> order;
+
+  std::vector<int> lengths;                       // LCS length of each pair.
+  std::vector<std::string> longest_subsequences; // LCS of each pair.
+
+  /* Index of the next pair that has not yet been claimed by a thread. */
+  std::atomic<size_t> next_pair;
+  /* Number of pairs claimed by a thread at a time. */
+  size_t chunk_size;
+
+  std::vector<Timer> thread_timers;
+  std::vector<double> thread_times_taken;
+  std::vector<size_t> thread_pairs_solved; // Number of pairs solved per thread.
+
+  Timer solve_timer;
+  double solve_time_taken = 0.0;
+
+  /* Padding codes for the SIMD kernel. They lie outside the range of
+  character codes and differ from each other, so padding never matches. */
+  static const int PAD_A = -1;
+  static const int PAD_B = -2;
+
+  /* Computes the LCS lengths of the group of up to LANES pairs starting at
+  `order[first]`. The cell loop is the same as the serial solver's, except
+  that each cell holds one entry per pair. Shorter pairs are padded at the end
+  with codes that never match, which leaves their bottom-right entry equal to
+  their own LCS length. Only two rows are kept, as no backtrace is done. */
+  template <typename Score, int LANES>
+  void solveLanes(size_t first)
+  {
+    size_t last = std::min(first + LANES, pairs.size());
+    int max_a = 0, max_b = 0;
+    for (size_t k = first; k < last; k++)
+    {
+      max_a = std::max(max_a, (int)pairs[order[k]].sequence_a.length());
+      max_b = std::max(max_b, (int)pairs[order[k]].sequence_b.length());
+    }
+
+    // Interleave the sequences so that entry [i * LANES + lane] is the i-th
+    // character of the pair in that lane.
+    std::vector<Score> codes_a(max_a * LANES, (Score)PAD_A);
+    std::vector<Score> codes_b(max_b * LANES, (Score)PAD_B);
+    for (size_t k = first; k < last; k++)
+    {
+      const SequencePair &pair = pairs[order[k]];
+      int lane = k - first;
+      for (size_t i = 0; i < pair.sequence_a.length(); i++)
+      {
+        codes_a[i * LANES + lane] = (unsigned char)pair.sequence_a[i];
+      }
+      for (size_t j = 0; j < pair.sequence_b.length(); j++)
+      {
+        codes_b[j * LANES + lane] = (unsigned char)pair.sequence_b[j];
+      }
+    }
+
+    std::vector<Score> rows(2 * (max_b + 1) * LANES, 0);
+    Score *prev = rows.data();
+    Score *cur = prev + (max_b + 1) * LANES;
+    for (int i = 1; i <= max_a; i++)
+    {
+      const Score *a = &codes_a[(i - 1) * LANES];
+      for (int j = 1; j <= max_b; j++)
+      {
+        const Score *b = &codes_b[(j - 1) * LANES];
+        const Score *top_left = &prev[(j - 1) * LANES];
+        const Score *top = &prev[j * LANES];
+        const Score *left = &cur[(j - 1) * LANES];
+        Score *cell = &cur[j * LANES];
+        /* Lanes are independent, so the lane loop maps onto vector
+        instructions. Without `unroll 1` the short lane loops get fully
+        unrolled before the vectorizer sees them. */
+#pragma GCC ivdep
+#pragma GCC unroll 1
+        for (int lane = 0; lane < LANES; lane++)
+        {
+          Score match = top_left[lane] + 1;
+          Score no_match = std::max(top[lane], left[lane]);
+          cell[lane] = (a[lane] == b[lane]) ? match : no_match;
+        }
+      }
+      std::swap(prev, cur);
+    }
+
+    for (size_t k = first; k < last; k++)
+    {
+      lengths[order[k]] = prev[max_b * LANES + (k - first)];
+    }
+  }
+
+  /* Picks the narrowest score type that can hold the group's results, since
+  narrower lanes mean more pairs per vector instruction. */
+  template <int LANES>
+  void solveGroup(size_t first)
+  {
+    size_t last = std::min(first + LANES, pairs.size());
+    size_t max_length = 0;
+    for (size_t k = first; k < last; k++)
+    {
+      max_length = std::max(max_length, pairs[order[k]].sequence_a.length());
+      max_length = std::max(max_length, pairs[order[k]].sequence_b.length());
+    }
+    if (max_length < (size_t)std::numeric_limits<int16_t>::max())
+    {
+      solveLanes<int16_t, LANES>(first);
+    }
+    else
+    {
+      solveLanes<int32_t, LANES>(first);
+    }
+  }
+
+  void solveGroup(size_t first)
+  {
+    switch (simd_lanes)
+    {
+    case 8:
+      solveGroup<8>(first);
+      break;
+    case 16:
+      solveGroup<16>(first);
+      break;
+    default:
+      solveGroup<32>(first);
+      break;
+    }
+  }
+
+  void solveBatch(int thread_id)
+  {
+    thread_timers[thread_id].start();
+    size_t n_pairs = pairs.size();
+    size_t n_solved = 0;
+
+    // Each thread reuses its own solver and result, so solving a pair does
+    // not allocate once the largest pair has been seen.
+    LCSSolver solver;
+    LCSResult result;
+
+    while (true)
+    {
+      // Claim the next chunk of unsolved pairs.
+      size_t first = next_pair.fetch_add(chunk_size);
+      if (first >= n_pairs)
+      {
+        break;
+      }
+      size_t last = std::min(first + chunk_size, n_pairs);
+      if (simd_lanes > 0)
+      {
+        // In SIMD mode a chunk is a single group of pairs.
+        solveGroup(first);
+        n_solved += last - first;
+        continue;
+      }
+      for (size_t index = first; index < last; index++)
+      {
+        solver.solve(pairs[index].sequence_a, pairs[index].sequence_b, result, length_only);
+        lengths[index] = result.length;
+        longest_subsequences[index] = result.subsequence;
+        n_solved++;
+      }
+    }
+
+    thread_pairs_solved[thread_id] = n_solved;
+    thread_times_taken[thread_id] = thread_timers[thread_id].stop();
+  }
+
+public:
+  /* `simd_lanes` must be 0 (scalar), 8, 16 or 32. */
+  LongestCommonSubsequenceBatch(const std::vector<SequencePair> &pairs,
+                                int threads, size_t chunk_size = 1,
+                                int simd_lanes = 0, bool length_only = false)
+      : pairs(pairs), numThreads(std::max(1, threads)),
+        simd_lanes(simd_lanes), length_only(length_only || simd_lanes > 0),
+        lengths(pairs.size(), 0), longest_subsequences(pairs.size()),
+        next_pair(0),
+        chunk_size(simd_lanes > 0 ? simd_lanes : std::max<size_t>(1, chunk_size)),
+        thread_timers(numThreads), thread_times_taken(numThreads, 0.0),
+        thread_pairs_solved(numThreads, 0)
+  {
+  }
+
+  virtual ~LongestCommonSubsequenceBatch() {}
+
+  virtual void solve()
+  {
+    solve_timer.start();
+    next_pair = 0;
+
+    if (simd_lanes > 0)
+    {
+      // Sort by length so that the pairs sharing a group need little padding.
+      order.resize(pairs.size());
+      for (size_t index = 0; index < pairs.size(); index++)
+      {
+        order[index] = index;
+      }
+      std::stable_sort(order.begin(), order.end(), [this](size_t x, size_t y)
+                       { return std::make_pair(pairs[x].sequence_a.length(), pairs[x].sequence_b.length()) <
+                                std::make_pair(pairs[y].sequence_a.length(), pairs[y].sequence_b.length()); });
+    }
+
+    std::vector<std::thread> threads(numThreads);
+    for (int i = 0; i < numThreads; i++)
+    {
+      threads[i] = std::thread(&LongestCommonSubsequenceBatch::solveBatch, this, i);
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+      threads[i].join();
+    }
+
+    solve_time_taken = solve_timer.stop();
+  }
+
+  const std::vector<int> &getLengths() const
+  {
+    return lengths;
+  }
+
+  const std::vector<std::string> &getLongestCommonSubsequences() const
+  {
+    return longest_subsequences;
+  }
+
+  /* Writes one `<length>,<lcs>` line per pair, in input order. In SIMD or
+  length-only mode only the length is written. */
+  void writeResults(std::ostream &out)
+  {
+    for (size_t index = 0; index < pairs.size(); index++)
+    {
+      out << lengths[index];
+      if (!length_only)
+      {
+        out << "," << longest_subsequences[index];
+      }
+      out << "\n";
+    }
+  }
+
+  void writeResults(const std::string &output_file_path)
+  {
+    std::ofstream out_file(output_file_path);
+    if (!out_file.is_open())
+    {
+      std::cerr << "Error writing file: " << output_file_path << std::endl;
+      exit(1);
+    }
+    writeResults(out_file);
+  }
+
+  void printThreadStats()
+  {
+    printf("\n-_-_-_-_-_-_-_ LCS Batch Statistics _-_-_-_-_-_-_-\n\n");
+    printf("Thread ID || Pairs Solved || Time Taken\n");
+    for (int id = 0; id < numThreads; id++)
+    {
+      printf("%9d || %12zu || %lf\n", id, thread_pairs_solved[id],
+             thread_times_taken[id]);
+    }
+    printf("Number of Pairs: %zu\n", pairs.size());
+    printf("Solve Time Taken: %f\n", solve_time_taken);
+  }
+};
+
+#endif
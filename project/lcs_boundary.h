@@ -0,0 +1,378 @@
+#ifndef _LCS_BOUNDARY_H_
+#define _LCS_BOUNDARY_H_
+
+#include <mpi.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Tag used for the boundary values passed between neighboring processes. */
+#define BOUNDARY_TAG 1
+
+/* How boundary values are passed between neighboring processes. */
+enum class BoundaryTransport
+{
+  TwoSided,     // MPI_Isend / MPI_Irecv.
+  SharedMemory, // Shared memory window between processes on the same node.
+  RMA,          // One-sided MPI_Put into a window of the receiving process.
+};
+
+/* Parses the name of a transport as given on the command line. Returns false
+if it is not recognized. */
+bool parse_boundary_transport(const std::string &name, BoundaryTransport &transport)
+{
+  if (name == "two_sided")
+  {
+    transport = BoundaryTransport::TwoSided;
+  }
+  else if (name == "shared")
+  {
+    transport = BoundaryTransport::SharedMemory;
+  }
+  else if (name == "rma")
+  {
+    transport = BoundaryTransport::RMA;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+/* What one end of a boundary link has sent and received. With RMA, every
+put and every flag update counts as a message. Links through shared memory
+pass no messages, so their traffic stays at zero. */
+struct LinkTraffic
+{
+  long long messages_sent = 0;
+  long long bytes_sent = 0;
+  long long messages_received = 0;
+  long long bytes_received = 0;
+};
+
+/**
+ * One direction of the boundary exchange between two neighboring processes.
+ *
+ * The sending process and the receiving process each have a link to the
+ * other, through which the boundary values of each block of rows pass in
+ * order. Both ends are double-buffered, so the sender can fill the buffer of
+ * the next block while the receiver is still reading the last one.
+ */
+class BoundaryLink
+{
+protected:
+  LinkTraffic traffic;
+
+public:
+  virtual ~BoundaryLink() {}
+
+  const LinkTraffic &getTraffic() const
+  {
+    return traffic;
+  }
+
+  /* Receiving end. postReceive() announces the next message of `count`
+  values, and may be called once ahead of waitReceive(). waitReceive()
+  returns the values of the oldest message, which stay valid until
+  releaseReceive(). */
+  virtual void postReceive(int count) = 0;
+  virtual const int *waitReceive() = 0;
+  virtual void releaseReceive() = 0;
+
+  /* Sending end. sendBuffer() returns the buffer to fill for the next
+  message, waiting until it is free, and send() sends the first `count`
+  values of it. */
+  virtual int *sendBuffer() = 0;
+  virtual void send(int count) = 0;
+  virtual void finishSends() = 0;
+};
+
+/* Boundary link using non-blocking point-to-point messages. A link is only
+ever used in one direction, so the two ends share the buffers. */
+class TwoSidedLink : public BoundaryLink
+{
+protected:
+  MPI_Comm comm;
+  int peer; // Rank of the neighbor in `comm`.
+  std::vector<int> buffers[2];
+  MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  int n_posted = 0;   // Receives posted.
+  int n_received = 0; // Receives completed.
+  int n_sent = 0;     // Sends started.
+
+public:
+  TwoSidedLink(MPI_Comm comm, int peer, int capacity)
+      : comm(comm), peer(peer)
+  {
+    buffers[0].resize(capacity);
+    buffers[1].resize(capacity);
+  }
+
+  virtual void postReceive(int count) override
+  {
+    int slot = n_posted++ % 2;
+    MPI_Irecv(buffers[slot].data(), count, MPI_INT, peer, BOUNDARY_TAG, comm,
+              &requests[slot]);
+  }
+
+  virtual const int *waitReceive() override
+  {
+    int slot = n_received % 2;
+    MPI_Status status;
+    MPI_Wait(&requests[slot], &status);
+    int bytes;
+    MPI_Get_count(&status, MPI_BYTE, &bytes);
+    traffic.messages_received++;
+    traffic.bytes_received += bytes;
+    return buffers[slot].data();
+  }
+
+  virtual void releaseReceive() override
+  {
+    n_received++;
+  }
+
+  virtual int *sendBuffer() override
+  {
+    // The buffer was last used two messages ago.
+    int slot = n_sent % 2;
+    MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+    return buffers[slot].data();
+  }
+
+  virtual void send(int count) override
+  {
+    int slot = n_sent++ % 2;
+    MPI_Isend(buffers[slot].data(), count, MPI_INT, peer, BOUNDARY_TAG, comm,
+              &requests[slot]);
+    traffic.messages_sent++;
+    traffic.bytes_sent += count * sizeof(int);
+  }
+
+  virtual void finishSends() override
+  {
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+  }
+};
+
+/**
+ * Boundary link between two processes on the same node, through a window
+ * created with MPI_Win_allocate_shared.
+ *
+ * The receiving process owns a segment of the window holding two message
+ * slots and, for each slot, a `ready` flag set by the sender and an `ack`
+ * flag set by the receiver, which count the messages that have passed
+ * through it. The sender writes the values straight into the receiver's
+ * slot, so no copies or MPI calls other than memory barriers are involved.
+ * Both processes must hold a passive lock on the window (MPI_Win_lock_all)
+ * while the link is in use.
+ */
+class SharedMemoryLink : public BoundaryLink
+{
+protected:
+  MPI_Win window;
+  int *ready;     // ready[slot]: number of the last message written to it, plus 1.
+  int *ack;       // ack[slot]: number of the last message read from it, plus 1.
+  int *slots[2];
+  int n_received = 0;
+  int n_sent = 0;
+
+  /* Waits until `*flag` reaches `value`. */
+  void waitFor(int *flag, int value)
+  {
+    while (__atomic_load_n(flag, __ATOMIC_ACQUIRE) < value)
+    {
+      MPI_Win_sync(window);
+      std::this_thread::yield();
+    }
+  }
+
+  /* Makes the preceding writes visible to the other process before `*flag`
+  is set. */
+  void signal(int *flag, int value)
+  {
+    MPI_Win_sync(window);
+    __atomic_store_n(flag, value, __ATOMIC_RELEASE);
+  }
+
+public:
+  /* Number of ints needed for a segment with slots of `capacity` values. */
+  static int segmentSize(int capacity)
+  {
+    return 4 + 2 * capacity;
+  }
+
+  /* `segment` is the receiving process's segment of `window`, which must
+  start out zeroed. */
+  SharedMemoryLink(MPI_Win window, int *segment, int capacity)
+      : window(window), ready(segment), ack(segment + 2)
+  {
+    slots[0] = segment + 4;
+    slots[1] = segment + 4 + capacity;
+  }
+
+  virtual void postReceive(int /*count*/) override
+  {
+  }
+
+  virtual const int *waitReceive() override
+  {
+    int slot = n_received % 2;
+    waitFor(&ready[slot], n_received + 1);
+    return slots[slot];
+  }
+
+  virtual void releaseReceive() override
+  {
+    int slot = n_received % 2;
+    n_received++;
+    signal(&ack[slot], n_received);
+  }
+
+  virtual int *sendBuffer() override
+  {
+    // Wait until the receiver has read the message sent two messages ago.
+    int slot = n_sent % 2;
+    waitFor(&ack[slot], n_sent - 1);
+    return slots[slot];
+  }
+
+  virtual void send(int /*count*/) override
+  {
+    int slot = n_sent % 2;
+    n_sent++;
+    signal(&ready[slot], n_sent);
+  }
+
+  virtual void finishSends() override
+  {
+  }
+};
+
+/**
+ * Boundary link using one-sided communication, through a window created with
+ * MPI_Win_allocate on which every process holds a passive lock
+ * (MPI_Win_lock_all) while the link is in use.
+ *
+ * Each process's segment of the window has the same layout as for
+ * SharedMemoryLink, but the `ack` flags there acknowledge the messages the
+ * process has sent, rather than those it has received, so that both ends only
+ * ever poll their own memory. The sender MPI_Puts the values into the
+ * receiver's slot and, once they have been flushed, sets the receiver's
+ * `ready` flag; the receiver sets the sender's `ack` flag once it has read
+ * them. The flags are only accessed with atomic operations (MPI_Accumulate and
+ * MPI_Fetch_and_op), so the two never race.
+ */
+class RMALink : public BoundaryLink
+{
+protected:
+  MPI_Win window;
+  int *segment; // This process's segment of the window.
+  int rank;     // Rank of this process in the window's communicator.
+  int peer;     // Rank of the neighbor.
+  int capacity;
+  std::vector<int> staging; // Values of the message being sent.
+  int flag_value = 0;       // Origin buffer for setting a remote flag.
+  int posted_counts[2];     // Values in each message announced by postReceive().
+  int n_posted = 0;
+  int n_received = 0;
+  int n_sent = 0;
+
+  /* Displacements within a segment. */
+  static int readyDisp(int slot) { return slot; }
+  static int ackDisp(int slot) { return 2 + slot; }
+  int slotDisp(int slot) const { return 4 + slot * capacity; }
+
+  int readLocalFlag(int disp)
+  {
+    int value;
+    MPI_Fetch_and_op(nullptr, &value, MPI_INT, rank, disp, MPI_NO_OP, window);
+    MPI_Win_flush(rank, window);
+    return value;
+  }
+
+  /* Waits until a flag in this process's segment reaches `value`. */
+  void waitFor(int disp, int value)
+  {
+    while (readLocalFlag(disp) < value)
+    {
+      std::this_thread::yield();
+    }
+    // Make the values written by the other process visible to local loads.
+    MPI_Win_sync(window);
+  }
+
+  void setRemoteFlag(int disp, int value)
+  {
+    flag_value = value;
+    MPI_Accumulate(&flag_value, 1, MPI_INT, peer, disp, 1, MPI_INT, MPI_REPLACE,
+                   window);
+    MPI_Win_flush(peer, window);
+    traffic.messages_sent++;
+    traffic.bytes_sent += sizeof(int);
+  }
+
+public:
+  static int segmentSize(int capacity)
+  {
+    return SharedMemoryLink::segmentSize(capacity);
+  }
+
+  /* `segment` is this process's segment of `window`, which must start out
+  zeroed. */
+  RMALink(MPI_Win window, int *segment, int rank, int peer, int capacity)
+      : window(window), segment(segment), rank(rank), peer(peer),
+        capacity(capacity), staging(capacity)
+  {
+  }
+
+  virtual void postReceive(int count) override
+  {
+    posted_counts[n_posted++ % 2] = count;
+  }
+
+  /* The sender's put of the values and update of the `ready` flag are
+  counted as received. Its acknowledgements are only counted by the
+  receiver, which sends them. */
+  virtual const int *waitReceive() override
+  {
+    int slot = n_received % 2;
+    waitFor(readyDisp(slot), n_received + 1);
+    traffic.messages_received += 2;
+    traffic.bytes_received += (posted_counts[slot] + 1) * sizeof(int);
+    return segment + slotDisp(slot);
+  }
+
+  virtual void releaseReceive() override
+  {
+    int slot = n_received % 2;
+    n_received++;
+    setRemoteFlag(ackDisp(slot), n_received);
+  }
+
+  virtual int *sendBuffer() override
+  {
+    return staging.data();
+  }
+
+  virtual void send(int count) override
+  {
+    // Wait until the receiver has read the message sent two messages ago.
+    int slot = n_sent % 2;
+    waitFor(ackDisp(slot), n_sent - 1);
+    MPI_Put(staging.data(), count, MPI_INT, peer, slotDisp(slot), count, MPI_INT,
+            window);
+    MPI_Win_flush(peer, window);
+    traffic.messages_sent++;
+    traffic.bytes_sent += count * sizeof(int);
+    n_sent++;
+    setRemoteFlag(readyDisp(slot), n_sent);
+  }
+
+  virtual void finishSends() override
+  {
+  }
+};
+
+#endif
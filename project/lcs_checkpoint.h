@@ -0,0 +1,269 @@
+#ifndef _LCS_CHECKPOINT_H_
+#define _LCS_CHECKPOINT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Checkpoints for long distributed runs.
+ *
+ * A checkpoint of generation g holds the state of every process after it has
+ * computed its first g blocks of rows. As a process only depends on the
+ * blocks of its neighbor to the left with the same index, such a state is
+ * consistent without saving any boundary values in flight: on restart, every
+ * process starts again at block g, and its neighbor to the left sends it the
+ * boundary values of block g onwards as usual.
+ *
+ * Each process writes its own file per generation, and the rightmost process
+ * writes a commit file once every process has written a generation, which
+ * records the generation to resume from.
+ */
+struct CheckpointConfig
+{
+  std::string directory;     // Directory for the checkpoint files, or empty.
+  int interval = 0;          // Blocks of rows between checkpoints (0 for none).
+  int resume_generation = 0; // Generation to resume from (0 to start over).
+};
+
+/* Fields of the commit file, which identify the run and the generation. */
+struct CheckpointCommit
+{
+  int world_size;
+  int length_a;
+  int length_b;
+  int block_rows;
+  int generation;
+};
+
+std::string checkpoint_file_path(const std::string &directory, int rank, int generation)
+{
+  return directory + "/rank_" + std::to_string(rank) + "_gen_" +
+         std::to_string(generation) + ".bin";
+}
+
+std::string checkpoint_commit_path(const std::string &directory)
+{
+  return directory + "/commit";
+}
+
+/* Files are written under a temporary name and then renamed, so that a file
+with the final name is always complete. */
+bool write_checkpoint_commit(const std::string &directory, const CheckpointCommit &commit)
+{
+  std::string path = checkpoint_commit_path(directory);
+  {
+    std::ofstream out_file(path + ".tmp");
+    if (!out_file.is_open())
+    {
+      return false;
+    }
+    out_file << commit.world_size << " " << commit.length_a << " "
+             << commit.length_b << " " << commit.block_rows << " "
+             << commit.generation << "\n";
+    if (!out_file.good())
+    {
+      return false;
+    }
+  }
+  return std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+}
+
+/* Returns false if there is no commit file. */
+bool read_checkpoint_commit(const std::string &directory, CheckpointCommit &commit)
+{
+  std::ifstream in_file(checkpoint_commit_path(directory));
+  if (!in_file.is_open())
+  {
+    return false;
+  }
+  return (bool)(in_file >> commit.world_size >> commit.length_a >>
+                commit.length_b >> commit.block_rows >> commit.generation);
+}
+
+bool write_checkpoint_row(const std::string &path, const std::vector<int> &row)
+{
+  {
+    std::ofstream out_file(path + ".tmp", std::ios::binary);
+    if (!out_file.is_open())
+    {
+      return false;
+    }
+    int size = row.size();
+    out_file.write((const char *)&size, sizeof(size));
+    out_file.write((const char *)row.data(), sizeof(int) * row.size());
+    if (!out_file.good())
+    {
+      return false;
+    }
+  }
+  return std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+}
+
+/* Reads a row written by write_checkpoint_row(), which must have the same
+size as `row`. */
+bool read_checkpoint_row(const std::string &path, std::vector<int> &row)
+{
+  std::ifstream in_file(path, std::ios::binary);
+  int size = -1;
+  if (!in_file.read((char *)&size, sizeof(size)) || size != (int)row.size())
+  {
+    return false;
+  }
+  return (bool)in_file.read((char *)row.data(), sizeof(int) * row.size());
+}
+
+/**
+ * Writes the checkpoints of one process on a background thread, so that the
+ * process only has to copy its state before carrying on with the next block.
+ */
+class CheckpointWriter
+{
+protected:
+  const std::string directory;
+  const int rank;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::pair<int, std::vector<int>>> queue; // Pending writes.
+  bool stopping = false;
+
+  /* The latest generation that has been completely written. */
+  std::atomic<int> durable_generation;
+  /* Generations that have files on disk. Only used by the owning process. */
+  std::vector<int> written_generations;
+  std::mutex written_mutex;
+
+  void run()
+  {
+    while (true)
+    {
+      std::pair<int, std::vector<int>> job;
+      {
+        std::unique_lock<std::mutex> ulock(mutex);
+        cv.wait(ulock, [this]
+                { return stopping || !queue.empty(); });
+        if (queue.empty())
+        {
+          return; // Stopping, and everything has been written.
+        }
+        job = std::move(queue.front());
+        queue.pop_front();
+      }
+      std::string path = checkpoint_file_path(directory, rank, job.first);
+      if (!write_checkpoint_row(path, job.second))
+      {
+        /* The generation is then never committed, so the run carries on from
+        the last one that was. */
+        std::cerr << "Warning: could not write checkpoint " << path << std::endl;
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(written_mutex);
+        written_generations.push_back(job.first);
+      }
+      durable_generation = job.first;
+    }
+  }
+
+public:
+  /* `generation` is the generation being resumed from, whose file already
+  exists, or 0. */
+  CheckpointWriter(const std::string &directory, int rank, int generation)
+      : directory(directory), rank(rank), durable_generation(generation)
+  {
+    if (generation > 0)
+    {
+      written_generations.push_back(generation);
+    }
+    thread = std::thread(&CheckpointWriter::run, this);
+  }
+
+  virtual ~CheckpointWriter()
+  {
+    stop();
+  }
+
+  /* Queues a copy of `row` to be written as the given generation. */
+  void write(int generation, const std::vector<int> &row)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.emplace_back(generation, row);
+    }
+    cv.notify_one();
+  }
+
+  int durableGeneration() const
+  {
+    return durable_generation;
+  }
+
+  /* Waits for the pending writes to finish. */
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    cv.notify_one();
+    if (thread.joinable())
+    {
+      thread.join();
+    }
+  }
+
+  /* Deletes the files of the generations before `generation`. */
+  void removeBefore(int generation)
+  {
+    std::lock_guard<std::mutex> lock(written_mutex);
+    std::vector<int> kept;
+    for (int written : written_generations)
+    {
+      if (written < generation)
+      {
+        std::remove(checkpoint_file_path(directory, rank, written).c_str());
+      }
+      else
+      {
+        kept.push_back(written);
+      }
+    }
+    written_generations.swap(kept);
+  }
+
+  /* Deletes every file of this process, including any left behind by an
+  earlier run that was interrupted before it could commit them. */
+  void removeAll()
+  {
+    removeBefore(std::numeric_limits<int>::max());
+    const std::string prefix = "rank_" + std::to_string(rank) + "_gen_";
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr)
+    {
+      return;
+    }
+    while (struct dirent *entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if (name.compare(0, prefix.length(), prefix) == 0)
+      {
+        std::remove((directory + "/" + name).c_str());
+      }
+    }
+    closedir(dir);
+  }
+};
+
+#endif
@@ -1,281 +1,524 @@
 
 
 #include <algorithm> // std::max, std::min
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <mpi.h>
+#include <thread>
+#include <vector>
 
 #include "cxxopts.hpp"
 #include "lcs.h"
+#include "lcs_batch.h"
+#include "lcs_distributed.h"
+#include "lcs_solver.h"
 
 /**
- * If the specific longest common subsequence is required, then the sub-matrices
- * can be gathered together once all of the entries have been computed.
+ * Where LCSDistributedLinearSpace reads a sequence from: a string held by
+ * every process, or the input file through MPI-IO, of which only the parts a
+ * process is working on are read. The processes of different sub-problems
+ * read at different times, so the reads are independent rather than
+ * collective.
+ */
+class SequenceReader
+{
+protected:
+  const std::string *sequence = nullptr;
+  InputFileMPI *input = nullptr;
+  MPI_Offset offset = 0; // Offset of the sequence in the input file.
+
+public:
+  SequenceReader(const std::string &sequence) : sequence(&sequence) {}
+  SequenceReader(InputFileMPI &input, const MPI_Offset offset)
+      : input(&input), offset(offset) {}
+
+  /* Returns `length` characters starting at `first`. */
+  std::string read(const int first, const int length) const
+  {
+    if (input == nullptr)
+    {
+      return sequence->substr(first, length);
+    }
+    std::string slice(length, '\0');
+    MPI_File_read_at(input->file, offset + first, &slice[0], length, MPI_CHAR,
+                     MPI_STATUS_IGNORE);
+    return slice;
+  }
+};
+
+/**
+ * Distributed linear-space LCS, after Hirschberg's algorithm.
+ *
+ * No process stores more than two rows of the matrix. The rows of a problem
+ * are split in half, and the processes compute the last row of scores of the
+ * top half from the top-left, and of the bottom half from the bottom-right,
+ * each over its own strip of columns in the same pipeline as LCSDistributed.
+ * The column at which the two rows sum to the largest value is one the LCS
+ * passes through on the middle row, which splits the problem into two
+ * independent sub-problems. The processes are divided between the two in
+ * proportion to their size, and each group carries on with its own. A group
+ * of a single process carries on alone, and sub-problems that are small
+ * enough are solved directly with LCSSolver.
  *
- * This version of the distributed LCS implementation tries to improve the
- * performance of the acquisition of the LCS subsequence by performing the
- * backtrace within the local processes and then using MPI send/receive to
- * let the next process know which index to pick up the task from.
+ * The pieces of the LCS are gathered on the root process in order of the row
+ * at which they start. The LCS has the same length as the one found by the
+ * other versions, but where there are several it may be a different one.
  *
- * */
-class LCSDistributed : public LongestCommonSubsequence
+ * A process only holds its strip of sequence_b for the current sub-problem,
+ * and streams the rows of sequence_a through it a chunk at a time, so when
+ * the sequences are read from the input file with MPI-IO no process ever
+ * holds either of them in full. Given strings instead, every process holds
+ * both sequences.
+ */
+class LCSDistributedLinearSpace : public LongestCommonSubsequence
 {
 protected:
   const int world_size;
   const int world_rank;
+  const int block_rows;
+  const SequenceReader reader_a;
+  const SequenceReader reader_b;
+  const int full_length_a;
+  const int full_length_b;
 
-  int lcs_length = -1; /* The length of the longest common subsequence. */
+  /* Sub-problems with at most this many entries are solved directly. */
+  static const long LEAF_CELLS = 1 << 20;
+  /* Characters of sequence_a or sequence_b read at a time when streaming. */
+  static const int CHUNK_LENGTH = 1 << 16;
 
-  /* Need to keep track of this info globally for MPI_Gatherv(). */
-  int *start_cols;
-  int *sub_str_widths;
-  std::string global_sequence_b;
+  /* The part of the LCS found by this process, and the row of the matrix at
+  which it starts (-1 if this process found none). */
+  std::string piece;
+  int piece_row = -1;
 
-  virtual void computeCell(const int row, const int col)
+  /* Computes the last row of scores of rows first..first + height - 1 of
+  sequence_a, in reverse order if `reversed` is set, against the strip of
+  columns `b`, as one stage of a pipeline of processes from `left_rank` to
+  `right_rank`. Entry 0 of `scores` is the entry in the column just to the
+  left of the strip, received from `left_rank` (0 if there is none). Only two
+  rows are kept, and the rows are read a chunk of whole blocks at a time. */
+  void computeLastRow(const int first, const int height, const bool reversed,
+                      const std::string &b, const int left_rank,
+                      const int right_rank, MPI_Comm comm,
+                      std::vector<int> &scores)
   {
-    int comm_value;
-    /* If we are computing a cell in the leftmost column of our local matrix,
-      then we need to get data from the cells in the rightmost column of our
-      neighboring process to the left. Unless we are the leftmost process. */
-    if (col == 1 && world_rank != 0)
+    const int width = b.length() + 1;
+    scores.assign(width, 0);
+    std::vector<int> current(width, 0);
+    std::vector<int> boundary(block_rows, 0);
+    const int chunk_rows = block_rows * std::max(1, CHUNK_LENGTH / block_rows);
+    std::string a; // Rows first_row - first_row % chunk_rows onwards.
+    for (int first_row = 0; first_row < height; first_row += block_rows)
     {
-      MPI_Recv(
-          &comm_value,
-          1, // Only need a single value.
-          MPI_UNSIGNED,
-          world_rank - 1, // Source: Get from neighbor to the left.
-          row,            // Tag: Row index.
-          MPI_COMM_WORLD,
-          MPI_STATUS_IGNORE);
-      // Store the value in the local matrix.
-      matrix[row][col - 1] = comm_value;
+      if (first_row % chunk_rows == 0)
+      {
+        const int n_rows = std::min(chunk_rows, height - first_row);
+        if (reversed)
+        {
+          a = reader_a.read(first + height - first_row - n_rows, n_rows);
+          std::reverse(a.begin(), a.end());
+        }
+        else
+        {
+          a = reader_a.read(first + first_row, n_rows);
+        }
+      }
+      const int count = std::min(block_rows, height - first_row);
+      if (left_rank != MPI_PROC_NULL)
+      {
+        MPI_Recv(boundary.data(), count, MPI_INT, left_rank, BOUNDARY_TAG, comm,
+                 MPI_STATUS_IGNORE);
+      }
+      else
+      {
+        std::fill(boundary.begin(), boundary.end(), 0); // Leftmost column of 0s.
+      }
+      for (int i = 0; i < count; i++)
+      {
+        const char c = a[first_row % chunk_rows + i];
+        current[0] = boundary[i];
+        for (int j = 1; j < width; j++)
+        {
+          if (c == b[j - 1])
+          {
+            current[j] = scores[j - 1] + 1;
+          }
+          else
+          {
+            current[j] = std::max(scores[j], current[j - 1]);
+          }
+        }
+        boundary[i] = current[width - 1];
+        std::swap(scores, current);
+      }
+      if (right_rank != MPI_PROC_NULL)
+      {
+        MPI_Send(boundary.data(), count, MPI_INT, right_rank, BOUNDARY_TAG, comm);
+      }
     }
+  }
 
-    LongestCommonSubsequence::computeCell(row, col);
+  /* Finds the LCS of rows a0..a1-1 of sequence_a and columns b0..b1-1 of
+  sequence_b with the processes of `comm`. */
+  void solveSubproblem(MPI_Comm comm, const int a0, const int a1,
+                       const int b0, const int b1)
+  {
+    int comm_size, comm_rank;
+    MPI_Comm_size(comm, &comm_size);
+    MPI_Comm_rank(comm, &comm_rank);
+    const int n_rows = a1 - a0;
+    const int n_cols = b1 - b0;
+    if (n_rows == 0 || n_cols == 0)
+    {
+      return;
+    }
+    if (n_rows == 1 || (long)n_rows * n_cols <= LEAF_CELLS)
+    {
+      if (comm_rank == 0)
+      {
+        if (n_rows == 1)
+        {
+          // The LCS is the character of the row if the columns contain it.
+          const char c = reader_a.read(a0, 1)[0];
+          for (int col = b0; col < b1; col += CHUNK_LENGTH)
+          {
+            if (reader_b.read(col, std::min(CHUNK_LENGTH, b1 - col)).find(c) != std::string::npos)
+            {
+              piece += c;
+              break;
+            }
+          }
+        }
+        else
+        {
+          LCSSolver solver;
+          piece += solver.solve(reader_a.read(a0, n_rows), reader_b.read(b0, n_cols))
+                       .subsequence;
+        }
+        if (piece_row < 0)
+        {
+          piece_row = a0;
+        }
+      }
+      return;
+    }
 
-    /* If we are computing a cell in the rightmost column of our local
-    matrix, we must send the results to our neighbor to the right once we
-    are done. Unless we are the rightmost process. */
-    if (col == matrix_width - 1 && world_rank != world_size - 1)
+    // Each process takes a strip of the columns.
+    std::vector<int> starts(comm_size), widths(comm_size);
+    splitRange(n_cols, comm_size, starts.data(), widths.data());
+    const int c0 = starts[comm_rank];
+    const int c1 = c0 + widths[comm_rank];
+    const int left_rank = comm_rank > 0 ? comm_rank - 1 : MPI_PROC_NULL;
+    const int right_rank = comm_rank < comm_size - 1 ? comm_rank + 1 : MPI_PROC_NULL;
+
+    /* forward[k - c0] is the LCS length of the top half against the first k
+    columns, and reverse[c1 - k] that of the bottom half against the rest. The
+    reverse scores are computed on the reversed sequences, with the pipeline
+    running from right to left. */
+    const int mid = a0 + n_rows / 2;
+    std::vector<int> forward, reverse;
+    std::string strip_b = reader_b.read(b0 + c0, c1 - c0);
+    computeLastRow(a0, mid - a0, false, strip_b, left_rank, right_rank, comm, forward);
+    std::reverse(strip_b.begin(), strip_b.end());
+    computeLastRow(mid, a1 - mid, true, strip_b, right_rank, left_rank, comm, reverse);
+    std::string().swap(strip_b); // Not needed by the sub-problems.
+
+    // Find the best split column over all processes (the leftmost on ties).
+    int best[2] = {-1, 0};
+    for (int k = c0; k <= c1; k++)
     {
-      comm_value = matrix[row][col];
-      MPI_Send(
-          &comm_value,
-          1,
-          MPI_UNSIGNED,
-          world_rank + 1, // Destination: Send to neighbor to the right.
-          row,
-          MPI_COMM_WORLD);
+      int score = forward[k - c0] + reverse[c1 - k];
+      if (score > best[0])
+      {
+        best[0] = score;
+        best[1] = k;
+      }
     }
-  }
+    MPI_Allreduce(MPI_IN_PLACE, best, 1, MPI_2INT, MPI_MAXLOC, comm);
+    const int split = b0 + best[1];
 
-  virtual void determineLongestSubsequenceLength()
-  {
-    /* Once the sub-matrices have been computed, we will need to send the
-    bottom right entry of the rightmost process to the root process. */
-    if (world_rank == world_size - 1)
+    const long top_cells = (long)(mid - a0) * (split - b0);
+    const long bottom_cells = (long)(a1 - mid) * (b1 - split);
+    if (comm_size == 1 || top_cells == 0 || bottom_cells == 0)
     {
-      lcs_length = LongestCommonSubsequence::getLongestSubsequenceLength();
-      MPI_Send(
-          &lcs_length,
-          1,
-          MPI_INT,
-          0,
-          0,
-          MPI_COMM_WORLD);
+      solveSubproblem(comm, a0, mid, b0, split);
+      solveSubproblem(comm, mid, a1, split, b1);
+      return;
     }
-    else if (world_rank == 0)
+
+    // Divide the processes between the two halves in proportion to their size.
+    int top_size = (int)std::llround(comm_size * (double)top_cells /
+                                     (top_cells + bottom_cells));
+    top_size = std::max(1, std::min(comm_size - 1, top_size));
+    const int color = comm_rank < top_size ? 0 : 1;
+    MPI_Comm sub_comm;
+    MPI_Comm_split(comm, color, comm_rank, &sub_comm);
+    if (color == 0)
     {
-      MPI_Recv(
-          &lcs_length,
-          1,
-          MPI_INT,
-          world_size - 1,
-          0, MPI_COMM_WORLD,
-          MPI_STATUS_IGNORE);
-      matrix_time_taken = matrix_timer.stop();
+      solveSubproblem(sub_comm, a0, mid, b0, split);
     }
+    else
+    {
+      solveSubproblem(sub_comm, mid, a1, split, b1);
+    }
+    MPI_Comm_free(&sub_comm);
   }
 
-  /* Broadcast the length of the LCS from the rightmost process to every other
-  process.*/
-  void broadcastLCSLength()
+  /* Gathers the pieces of the LCS on the root process, in order. */
+  void gatherPieces()
   {
-    if (world_rank == world_size - 1)
+    int info[2] = {piece_row, (int)piece.length()};
+    std::vector<int> infos(world_rank == 0 ? 2 * world_size : 0);
+    MPI_Gather(info, 2, MPI_INT, infos.data(), 2, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<int> counts, displacements;
+    std::vector<char> pieces;
+    if (world_rank == 0)
     {
-      lcs_length = LongestCommonSubsequence::getLongestSubsequenceLength();
+      int total = 0;
+      for (int rank = 0; rank < world_size; rank++)
+      {
+        counts.push_back(infos[2 * rank + 1]);
+        displacements.push_back(total);
+        total += counts[rank];
+      }
+      pieces.resize(total);
     }
+    MPI_Gatherv(piece.data(), piece.length(), MPI_CHAR, pieces.data(),
+                counts.data(), displacements.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
 
-    MPI_Bcast(&lcs_length, 1, MPI_INT, world_size - 1, MPI_COMM_WORLD);
+    if (world_rank == 0)
+    {
+      std::vector<int> ranks(world_size);
+      for (int rank = 0; rank < world_size; rank++)
+      {
+        ranks[rank] = rank;
+      }
+      std::sort(ranks.begin(), ranks.end(), [&infos](int x, int y)
+                { return infos[2 * x] < infos[2 * y]; });
+      for (int rank : ranks)
+      {
+        longest_common_subsequence.append(pieces.data() + displacements[rank], counts[rank]);
+      }
+    }
   }
 
-  virtual void determineLongestCommonSubsequence() override
+  virtual void solve() override
+  {
+    timer.start();
+    matrix_timer.start();
+    solveSubproblem(MPI_COMM_WORLD, 0, full_length_a, 0, full_length_b);
+    matrix_time_taken = matrix_timer.stop();
+    gatherPieces();
+    time_taken = timer.stop();
+  }
+
+public:
+  /* The sequences are only accessed through the readers, and must stay
+  available until the constructor returns. */
+  LCSDistributedLinearSpace(
+      const SequenceReader &reader_a,
+      const SequenceReader &reader_b,
+      const int length_a,
+      const int length_b,
+      const int world_size,
+      const int world_rank,
+      const int block_rows = 1)
+      : LongestCommonSubsequence(SequenceView(), SequenceView(), false),
+        world_size(world_size),
+        world_rank(world_rank),
+        block_rows(std::max(1, block_rows)),
+        reader_a(reader_a),
+        reader_b(reader_b),
+        full_length_a(length_a),
+        full_length_b(length_b)
   {
-    /* Each process will need to know the length of the LCS so that it can
-    allocate the necessary buffer space. */
-    broadcastLCSLength();
+    this->solve();
+  }
 
-    char *lcs_buffer;
-    lcs_buffer = new char[lcs_length + 1];
-    lcs_buffer[lcs_length] = '\0';
-    int index = lcs_length - 1;
+  virtual ~LCSDistributedLinearSpace()
+  {
+  }
 
-    int comm_buffer[2]; // Used to transmit row index and LCS string index.
-    int row = matrix_height - 1;
-    /* Each process except the rightmost will have to wait for its neighbor to
-    the right to finish. */
+  /* Only valid on the root process. */
+  virtual int getLongestSubsequenceLength() override
+  {
+    return longest_common_subsequence.length();
+  }
 
-    if (world_rank != world_size - 1)
-    {
-      /* Rightside neighbor must tell us which row to start at. */
-      MPI_Recv(
-          &comm_buffer,
-          2,
-          MPI_INT,
-          world_rank + 1,
-          0,
-          MPI_COMM_WORLD,
-          MPI_STATUS_IGNORE);
-      row = comm_buffer[0];
-      index = comm_buffer[1];
+  virtual void printInfo() override
+  {
+    std::cout << "Longest common subsequence: " << longest_common_subsequence << "\n";
+    printLCSLength();
+  }
 
-      /* Next, the process needs to receive the partially completed LCS from
-      the neighbor to the right. */
-      MPI_Recv(
-          lcs_buffer,
-          lcs_length,
-          MPI_CHAR,
-          world_rank + 1,
-          0,
-          MPI_COMM_WORLD,
-          MPI_STATUS_IGNORE);
+  virtual void print() override
+  {
+    if (world_rank == 0)
+    {
+      printInfo();
+      printf("\n");
+      printTimeTaken();
     }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+};
+
+/**
+ * Distributed bit-parallel computation of the length of the LCS.
+ *
+ * Uses the bit-vector algorithm of Allison and Dix (in the form given by
+ * Hyyro), in which a whole column of the matrix is represented by a vector V
+ * of length_a bits, one per character of sequence_a, and each character c of
+ * sequence_b updates it with
+ *
+ *   V = (V + (V & M[c])) | (V & ~M[c])
+ *
+ * where bit i of M[c] is set if sequence_a[i] == c. After the last character,
+ * the length of the LCS is the number of zero bits in V. This computes 64
+ * entries of the matrix per machine word.
+ *
+ * The words of V are split between the processes, and the only dependency
+ * between words is the carry of the addition. As in LCSDistributed, each
+ * process works through sequence_b in blocks of characters, and passes the
+ * carry out of its last word for each character of the block on to its
+ * neighbor to the right, packed into a single message per block.
+ */
+class LCSDistributedBitParallel : public LongestCommonSubsequence
+{
+protected:
+  const int world_size;
+  const int world_rank;
+  const int block_rows; // Characters of sequence_b per message.
 
-    /* Once we have acquired the necessary data from our neighbor, we can
-    continue the trace. Always starting from the leftmost column. */
-    int col = matrix_width - 1;
+  int lcs_length = -1;
 
-    int current, top, left, top_left;
-    top = left = top_left = 0;
+  /* The local words of V, and the matching masks of the local slice of
+  sequence_a: mask k occupies words [k * n_words, (k + 1) * n_words) of
+  `masks`, and mask 0 is all zeros, for characters that do not occur in the
+  slice. */
+  int n_words;
+  std::vector<uint64_t> vector_bits;
+  std::vector<uint64_t> masks;
+  int mask_index[256];
 
-    while (row > 0 && col > 0 && index >= 0)
+  void buildMasks()
+  {
+    std::fill(mask_index, mask_index + 256, 0);
+    int n_masks = 1;
+    for (int i = 0; i < length_a; i++)
     {
-      current = matrix[row][col];
-      top_left = matrix[row - 1][col - 1];
-      top = matrix[row - 1][col];
-      left = matrix[row][col - 1];
-
-      if (top_left == current)
+      unsigned char c = sequence_a[i];
+      if (mask_index[c] == 0)
       {
-        // Go to entry to the top-left.
-        row--;
-        col--;
-        continue;
+        mask_index[c] = n_masks++;
       }
+    }
+    masks.assign((size_t)n_masks * n_words, 0);
+    for (int i = 0; i < length_a; i++)
+    {
+      uint64_t *mask = &masks[(size_t)mask_index[(unsigned char)sequence_a[i]] * n_words];
+      mask[i / 64] |= (uint64_t)1 << (i % 64);
+    }
+  }
 
-      /* If the elements above, to the left, and diagonally to the top left
-      are all the same,  */
-      if (top_left == top && top_left == left)
-      {
-        lcs_buffer[index] = sequence_a[row - 1];
-        index--;
-        // Go to entry to the top-left.
-        row--;
-        col--;
-        continue;
-      }
+  void solveDistributed()
+  {
+    matrix_timer.start();
+    const int left_rank = world_rank > 0 ? world_rank - 1 : MPI_PROC_NULL;
+    const int right_rank = world_rank < world_size - 1 ? world_rank + 1 : MPI_PROC_NULL;
 
-      /* If the entry to the top left is lower than the current entry but is not
-      equal to the entries above and to the left, then either the one above or
-      the one to the left must be the same as the current. */
-      if (top == current)
+    vector_bits.assign(n_words, ~(uint64_t)0);
+    std::vector<uint64_t> carries((block_rows + 63) / 64, 0);
+    uint64_t *bits = vector_bits.data();
+    for (int first = 0; first < length_b; first += block_rows)
+    {
+      const int count = std::min(block_rows, length_b - first);
+      const int n_carry_words = (count + 63) / 64;
+      if (left_rank != MPI_PROC_NULL)
       {
-        // Go to the entry above.
-        row--;
-        continue;
+        MPI_Recv(carries.data(), n_carry_words, MPI_UINT64_T, left_rank,
+                 BOUNDARY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
       }
       else
       {
-        // If it wasn't the one above, it must be the one to the left.
-        col--;
+        std::fill(carries.begin(), carries.end(), 0); // Nothing carries in.
       }
-    }
-
-    /* Once this process has finished tracing its sub-matrix, pass the work on
-    to the next process. */
-    if (world_rank > 0)
-    {
-      comm_buffer[0] = row;
-      comm_buffer[1] = index;
-      MPI_Send(
-          &comm_buffer,
-          2,
-          MPI_INT,
-          world_rank - 1,
-          0,
-          MPI_COMM_WORLD);
 
-      MPI_Send(
-          lcs_buffer,
-          lcs_length,
-          MPI_CHAR,
-          world_rank - 1,
-          0,
-          MPI_COMM_WORLD);
-    }
+      for (int i = 0; i < count; i++)
+      {
+        const uint64_t *mask = &masks[(size_t)mask_index[(unsigned char)sequence_b[first + i]] * n_words];
+        uint64_t carry = (carries[i / 64] >> (i % 64)) & 1;
+        for (int w = 0; w < n_words; w++)
+        {
+          uint64_t matches = bits[w] & mask[w];
+          uint64_t sum = bits[w] + matches;
+          uint64_t carry_out = sum < matches;
+          sum += carry;
+          carry_out |= sum < carry;
+          carry = carry_out;
+          bits[w] = sum | (bits[w] & ~mask[w]);
+        }
+        carries[i / 64] = (carries[i / 64] & ~((uint64_t)1 << (i % 64))) | (carry << (i % 64));
+      }
 
-    if (world_rank == 0)
-    {
-      longest_common_subsequence = lcs_buffer;
+      if (right_rank != MPI_PROC_NULL)
+      {
+        MPI_Send(carries.data(), n_carry_words, MPI_UINT64_T, right_rank,
+                 BOUNDARY_TAG, MPI_COMM_WORLD);
+      }
     }
-    delete[] lcs_buffer;
-  }
 
-  void solveDistributed()
-  {
-    matrix_timer.start();
-    for (int row = 1; row < matrix_height; row++)
+    // Count the zero bits, ignoring the unused bits of the last word.
+    int zeros = 0;
+    for (int w = 0; w < n_words; w++)
     {
-      for (int col = 1; col < matrix_width; col++)
+      uint64_t bits_used = ~(uint64_t)0;
+      if (length_a - 64 * w < 64)
       {
-        computeCell(row, col);
+        bits_used = ((uint64_t)1 << (length_a - 64 * w)) - 1;
       }
+      zeros += __builtin_popcountll(~bits[w] & bits_used);
     }
-    // MPI_Barrier(MPI_COMM_WORLD);
-    matrix_time_taken = timer.stop();
+    MPI_Reduce(&zeros, &lcs_length, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    matrix_time_taken = matrix_timer.stop();
   }
 
   virtual void solve() override
   {
     timer.start();
     solveDistributed();
-    determineLongestCommonSubsequence();
     time_taken = timer.stop();
   }
 
 public:
-  LCSDistributed(
+  /* `sequence_a` is this process's slice of the first sequence, which must
+  start at a multiple of 64 characters, and `sequence_b` is the whole of the
+  second sequence. */
+  LCSDistributedBitParallel(
       const std::string &sequence_a,
       const std::string &sequence_b,
       const int world_size,
       const int world_rank,
-      int *start_cols,
-      int *sub_str_widths,
-      const std::string &global_sequence_b)
-      : LongestCommonSubsequence(sequence_a, sequence_b),
+      const int block_rows = 1)
+      : LongestCommonSubsequence(sequence_a, sequence_b, false),
         world_size(world_size),
         world_rank(world_rank),
-        start_cols(start_cols),
-        sub_str_widths(sub_str_widths),
-        global_sequence_b(global_sequence_b)
+        block_rows(std::max(1, block_rows)),
+        n_words((length_a + 63) / 64)
   {
-
+    buildMasks();
     this->solve();
   }
 
-  virtual ~LCSDistributed()
+  virtual ~LCSDistributedBitParallel()
   {
   }
 
+  /* Only valid on the root process. */
   virtual int getLongestSubsequenceLength() override
   {
     return lcs_length;
@@ -283,95 +526,365 @@ public:
 
   virtual void printInfo() override
   {
-    std::cout << "Longest common subsequence: " << longest_common_subsequence << "\n";
     printLCSLength();
   }
 
-  void printPerProcessMatrices()
+  virtual void print() override
   {
-    for (int rank = 0; rank < world_size; rank++)
+    if (world_rank == 0)
+    {
+      printInfo();
+      printf("\n");
+      printTimeTaken();
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+};
+
+/* Tags used for the chunks of pairs handed out to the workers, and for the
+results they send back. */
+#define TASK_TAG 4
+#define RESULT_TAG 5
+
+/**
+ * Solves a batch of independent sequence pairs with a master/worker farm.
+ *
+ * Rank 0 reads the batch file and hands the pairs out to the other ranks in
+ * tasks of `chunk_size` pairs per worker thread. Each worker solves a task
+ * with LongestCommonSubsequenceBatch, the same engine as the lcs_parallel
+ * batch mode, on `n_threads` threads and with `simd_lanes` pairs per vector
+ * if set, and sends back its results as its request for the next task.
+ * Workers that draw short pairs therefore simply come back sooner. Rank 0
+ * writes each result out, in input order, as soon as every pair before it has
+ * been solved. With a single process, rank 0 solves every pair itself.
+ */
+class LCSDistributedBatch
+{
+protected:
+  const int world_size;
+  const int world_rank;
+  const int chunk_size;  // Pairs claimed by a worker thread at a time.
+  const int n_threads;   // Threads per worker.
+  const int simd_lanes;  // Pairs per vector, or 0 for scalar.
+  const bool length_only; // Set whenever `simd_lanes` is.
+  const int task_size;   // Pairs handed to a worker at a time.
+
+  /* Only used on rank 0. */
+  const std::vector<SequencePair> &pairs;
+  std::ostream *out = nullptr;
+  std::vector<int> lengths;
+  std::vector<std::string> subsequences; // Cleared once written.
+  std::vector<char> solved;
+  size_t next_to_write = 0;
+
+  Timer timer;
+  double time_taken = 0.0;
+  int pairs_solved = 0; // By this process.
+
+  /* Records the result of a pair, and writes out every result that is no
+  longer waiting on an earlier pair. */
+  void storeResult(const int index, const int length, const std::string &subsequence)
+  {
+    lengths[index] = length;
+    subsequences[index] = subsequence;
+    solved[index] = 1;
+    while (next_to_write < pairs.size() && solved[next_to_write])
     {
-      if (rank == world_rank)
+      *out << lengths[next_to_write];
+      if (!length_only)
       {
-        std::cout << "\nRank: " << world_rank << "\n";
-        printMatrix();
+        *out << "," << subsequences[next_to_write];
       }
-      MPI_Barrier(MPI_COMM_WORLD);
+      *out << "\n";
+      std::string().swap(subsequences[next_to_write]);
+      next_to_write++;
     }
   }
 
-  virtual void printTotalTimeTaken()
+  /* Sends the pairs first..first + count - 1 to a worker, as their lengths
+  followed by their characters. A count of 0 tells the worker to stop. */
+  void sendTask(const int worker, const int first, const int count)
   {
-    if (world_rank == 0)
+    std::vector<int> header = {first, count};
+    std::vector<char> characters;
+    for (int index = first; index < first + count; index++)
+    {
+      const SequencePair &pair = pairs[index];
+      header.push_back(pair.sequence_a.length());
+      header.push_back(pair.sequence_b.length());
+      characters.insert(characters.end(), pair.sequence_a.begin(), pair.sequence_a.end());
+      characters.insert(characters.end(), pair.sequence_b.begin(), pair.sequence_b.end());
+    }
+    MPI_Send(header.data(), header.size(), MPI_INT, worker, TASK_TAG, MPI_COMM_WORLD);
+    if (count > 0)
     {
-      printf("Total time taken: %lf\n", time_taken);
+      MPI_Send(characters.data(), characters.size(), MPI_CHAR, worker, TASK_TAG,
+               MPI_COMM_WORLD);
     }
   }
 
-  void printStats(int rank, double time)
+  /* Receives a message of unknown size into `buffer`. */
+  template <typename T>
+  void receiveAll(std::vector<T> &buffer, MPI_Datatype type, const int source, const int tag)
   {
-    if (world_rank != 0)
-      return;
+    MPI_Status status;
+    MPI_Probe(source, tag, MPI_COMM_WORLD, &status);
+    int size;
+    MPI_Get_count(&status, type, &size);
+    buffer.resize(size);
+    MPI_Recv(buffer.data(), size, type, source, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  }
 
-    printf("%4d | %6d | %lf\n",
-           rank,
-           sub_str_widths[rank],
-           time);
+  /* Solves `task` on this process's threads, and passes each result to
+  `store` in order. */
+  template <typename Store>
+  void solveTask(const std::vector<SequencePair> &task, Store store)
+  {
+    LongestCommonSubsequenceBatch batch(task, n_threads, chunk_size, simd_lanes, length_only);
+    batch.solve();
+    const std::vector<int> &task_lengths = batch.getLengths();
+    const std::vector<std::string> &task_subsequences = batch.getLongestCommonSubsequences();
+    for (size_t k = 0; k < task.size(); k++)
+    {
+      store(k, task_lengths[k], task_subsequences[k]);
+    }
+    pairs_solved += task.size();
   }
 
-  void printPerProcessStats()
+  void runMaster()
   {
-    if (world_rank == 0)
+    if (world_size == 1)
     {
-      printf("rank | n_cols | time_taken\n");
-      printStats(0, matrix_time_taken);
+      solveTask(pairs, [this](size_t index, int length, const std::string &subsequence)
+                { storeResult(index, length, subsequence); });
+      return;
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
-    /* Send stats to root process to ensure proper ordering of print statements. */
-    for (int rank = 1; rank < world_size; rank++)
+    size_t next_pair = 0;
+    int n_working = world_size - 1;
+    std::vector<int> header;
+    std::vector<char> characters;
+    while (n_working > 0)
     {
+      /* Results are sent as a header of [first, count, lengths...], followed
+      by the subsequences unless only the lengths are needed. */
+      MPI_Status status;
+      MPI_Probe(MPI_ANY_SOURCE, RESULT_TAG, MPI_COMM_WORLD, &status);
+      const int worker = status.MPI_SOURCE;
+      receiveAll(header, MPI_INT, worker, RESULT_TAG);
+      const int count = header[1];
+      if (count > 0 && !length_only)
+      {
+        receiveAll(characters, MPI_CHAR, worker, RESULT_TAG);
+      }
+      size_t offset = 0;
+      for (int k = 0; k < count; k++)
+      {
+        const int length = header[2 + k];
+        std::string subsequence;
+        if (!length_only)
+        {
+          subsequence.assign(characters.begin() + offset, characters.begin() + offset + length);
+          offset += length;
+        }
+        storeResult(header[0] + k, length, subsequence);
+      }
 
-      if (rank == world_rank)
+      if (next_pair < pairs.size())
       {
-        MPI_Send(
-            &time_taken,
-            1,
-            MPI_DOUBLE,
-            0,
-            0,
-            MPI_COMM_WORLD);
+        const int count = std::min((size_t)task_size, pairs.size() - next_pair);
+        sendTask(worker, next_pair, count);
+        next_pair += count;
       }
-      else if (world_rank == 0)
+      else
       {
-        double time;
-        MPI_Recv(
-            &time,
-            1,
-            MPI_DOUBLE,
-            rank,
-            0,
-            MPI_COMM_WORLD,
-            MPI_STATUS_IGNORE);
-        printStats(rank, time);
+        sendTask(worker, 0, 0);
+        n_working--;
       }
     }
   }
 
-  virtual void print() override
+  void runWorker()
+  {
+    std::vector<SequencePair> task;
+    // The first message carries no results, and only asks for work.
+    std::vector<int> results = {0, 0};
+    std::vector<char> result_characters;
+    std::vector<int> header;
+    std::vector<char> characters;
+    while (true)
+    {
+      MPI_Send(results.data(), results.size(), MPI_INT, 0, RESULT_TAG, MPI_COMM_WORLD);
+      if (results[1] > 0 && !length_only)
+      {
+        MPI_Send(result_characters.data(), result_characters.size(), MPI_CHAR, 0,
+                 RESULT_TAG, MPI_COMM_WORLD);
+      }
+
+      receiveAll(header, MPI_INT, 0, TASK_TAG);
+      const int count = header[1];
+      if (count == 0)
+      {
+        break;
+      }
+      receiveAll(characters, MPI_CHAR, 0, TASK_TAG);
+
+      task.resize(count);
+      size_t offset = 0;
+      for (int k = 0; k < count; k++)
+      {
+        const int length_a = header[2 + 2 * k];
+        const int length_b = header[3 + 2 * k];
+        task[k].sequence_a.assign(characters.begin() + offset, characters.begin() + offset + length_a);
+        offset += length_a;
+        task[k].sequence_b.assign(characters.begin() + offset, characters.begin() + offset + length_b);
+        offset += length_b;
+      }
+
+      results.assign({header[0], count});
+      result_characters.clear();
+      solveTask(task, [&](size_t, int length, const std::string &subsequence)
+                {
+                  results.push_back(length);
+                  result_characters.insert(result_characters.end(), subsequence.begin(),
+                                           subsequence.end());
+                });
+    }
+  }
+
+public:
+  /* `pairs` and `out` are only used on rank 0. `simd_lanes` must be 0
+  (scalar), 8, 16 or 32, and implies `length_only`. */
+  LCSDistributedBatch(const std::vector<SequencePair> &pairs, std::ostream *out,
+                      const int world_size, const int world_rank,
+                      const int chunk_size, const bool length_only,
+                      const int n_threads = 1, const int simd_lanes = 0)
+      : world_size(world_size), world_rank(world_rank), chunk_size(chunk_size),
+        n_threads(n_threads), simd_lanes(simd_lanes),
+        length_only(length_only || simd_lanes > 0),
+        // In SIMD mode a thread claims a whole group of pairs at a time.
+        task_size((simd_lanes > 0 ? simd_lanes : chunk_size) * n_threads),
+        pairs(pairs), out(out)
   {
-    printPerProcessStats();
-    MPI_Barrier(MPI_COMM_WORLD);
     if (world_rank == 0)
     {
-      printInfo();
-      printf("\n");
-      printTimeTaken();
+      lengths.resize(pairs.size());
+      subsequences.resize(pairs.size());
+      solved.assign(pairs.size(), 0);
     }
-    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  void solve()
+  {
+    timer.start();
+    if (world_rank == 0)
+    {
+      runMaster();
+      out->flush();
+    }
+    else
+    {
+      runWorker();
+    }
+    time_taken = timer.stop();
+  }
+
+  void printRankStats()
+  {
+    std::vector<int> rank_pairs_solved(world_size);
+    std::vector<double> rank_times_taken(world_size);
+    MPI_Gather(&pairs_solved, 1, MPI_INT, rank_pairs_solved.data(), 1, MPI_INT, 0,
+               MPI_COMM_WORLD);
+    MPI_Gather(&time_taken, 1, MPI_DOUBLE, rank_times_taken.data(), 1, MPI_DOUBLE, 0,
+               MPI_COMM_WORLD);
+    if (world_rank != 0)
+    {
+      return;
+    }
+    printf("\n-_-_-_-_-_-_-_ LCS Batch Statistics _-_-_-_-_-_-_-\n\n");
+    printf("Rank || Pairs Solved || Time Taken\n");
+    for (int rank = 0; rank < world_size; rank++)
+    {
+      printf("%4d || %12d || %lf\n", rank, rank_pairs_solved[rank], rank_times_taken[rank]);
+    }
+    printf("Number of Pairs: %zu\n", pairs.size());
+    printf("Solve Time Taken: %f\n", time_taken);
   }
 };
 
+/* Runs LCSDistributed with `n_ranks` threads of this process standing in for
+the MPI processes, communicating through a ThreadTransport. MPI is not used,
+so this can be run without an MPI launcher, to test the decomposition or to
+profile it with many more ranks than there are machines. */
+int run_simulated_ranks(const std::string &sequence_a, const std::string &sequence_b,
+                        const int n_ranks, const int grid_rows, const int block_rows,
+                        const bool length_only, const bool parallel_traceback,
+                        const std::string &stats_file)
+{
+  const int length_a = sequence_a.length();
+  const int length_b = sequence_b.length();
+  if (n_ranks % grid_rows != 0 || grid_rows > length_a)
+  {
+    std::cerr << "Error: grid rows must divide the number of processes and "
+                 "cannot exceed the length of sequence A."
+              << std::endl;
+    return 1;
+  }
+  const int grid_cols = n_ranks / grid_rows;
+
+  printf("-------------------- LCS Distributed --------------------\n");
+  printf("n_processes: %d (simulated)\n", n_ranks);
+  printf("process grid: %d x %d\n\n", grid_rows, grid_cols);
+
+  std::vector<int> sub_str_widths(grid_cols), start_cols(grid_cols);
+  splitRange(length_b, grid_cols, start_cols.data(), sub_str_widths.data());
+  std::vector<int> sub_str_heights(grid_rows), start_rows(grid_rows);
+  splitRange(length_a, grid_rows, start_rows.data(), sub_str_heights.data());
+
+  ThreadWorld world(n_ranks, grid_rows);
+  std::vector<std::thread> threads;
+  std::atomic<bool> stats_failed(false);
+  for (int rank = 0; rank < n_ranks; rank++)
+  {
+    threads.emplace_back([&, rank]
+                         {
+      ThreadTransport transport(world, rank);
+      int coords[2];
+      transport.gridCoords(rank, coords);
+      const int start_row = start_rows[coords[0]];
+      const int start_col = start_cols[coords[1]];
+      std::string local_sequence_a = sequence_a.substr(start_row, sub_str_heights[coords[0]]);
+      std::string local_sequence_b = sequence_b.substr(start_col, sub_str_widths[coords[1]]);
+
+      int rank_block_rows = block_rows;
+      if (rank_block_rows == 0)
+      {
+        rank_block_rows = chooseBlockRows(local_sequence_a, local_sequence_b,
+                                          sub_str_widths[coords[1]], grid_cols, transport);
+      }
+      if (rank == 0)
+      {
+        printf("block_rows: %d\n\n", rank_block_rows);
+      }
+
+      LCSDistributed lcs(local_sequence_a, local_sequence_b, n_ranks, rank,
+                         start_cols.data(), sub_str_widths.data(), transport,
+                         start_row, start_col, rank_block_rows, length_only,
+                         CheckpointConfig(), parallel_traceback);
+      lcs.print();
+      if (stats_file != "" && !lcs.writePerProcessStats(stats_file))
+      {
+        std::cerr << "Error writing file: " << stats_file << std::endl;
+        stats_failed = true;
+      } });
+  }
+  for (std::thread &thread : threads)
+  {
+    thread.join();
+  }
+  return stats_failed ? 1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
   cxxopts::Options options("lcs_distributed",
@@ -385,7 +898,45 @@ int main(int argc, char *argv[])
           {"sequence_b", "Second input sequence.",
            cxxopts::value<std::string>()->default_value("")}, // Second input sequence
           {"input_file", "Path to input .csv file.",
-           cxxopts::value<std::string>()->default_value("")} // Input file.
+           cxxopts::value<std::string>()->default_value("")}, // Input file.
+          {"batch_file", "Path to .csv file containing one pair of sequences per line.",
+           cxxopts::value<std::string>()->default_value("")}, // Batch input file.
+          {"output_file", "Path to .csv file to write batch results to.",
+           cxxopts::value<std::string>()->default_value("")}, // Batch output file.
+          {"chunk_size", "Number of pairs claimed by a worker thread at a time in batch mode.",
+           cxxopts::value<int>()->default_value("1")}, // Batch chunk size.
+          {"n_threads", "Number of threads per process in batch mode.",
+           cxxopts::value<int>()->default_value("1")}, // Batch threads per process.
+          {"simd_lanes", "Solve batch lengths with one pair per SIMD lane (8, 16 or 32).",
+           cxxopts::value<int>()->default_value("0")}, // SIMD lanes, 0 disables.
+          {"mpi_io", "Read only each process's part of the input file, with MPI-IO.",
+           cxxopts::value<bool>()->default_value("false")}, // Sliced input loading.
+          {"block_rows", "Rows computed between boundary messages (0 to choose automatically).",
+           cxxopts::value<int>()->default_value("0")}, // Row-block height.
+          {"grid_rows", "Number of rows of processes in the process grid.",
+           cxxopts::value<int>()->default_value("1")}, // Process grid height.
+          {"weights_file", "File with the relative speed of each process, to split the columns in proportion.",
+           cxxopts::value<std::string>()->default_value("")}, // Per-process weights.
+          {"calibrate", "Measure the speed of each process, to split the columns in proportion.",
+           cxxopts::value<bool>()->default_value("false")}, // Weight calibration.
+          {"simulate_ranks", "Run this many ranks as threads of a single process, without MPI.",
+           cxxopts::value<int>()->default_value("0")}, // Simulated ranks.
+          {"transport", "How boundary values are passed between neighboring processes: two_sided, shared or rma.",
+           cxxopts::value<std::string>()->default_value("two_sided")}, // Boundary transport.
+          {"linear_space", "Find the LCS in linear space with Hirschberg's algorithm.",
+           cxxopts::value<bool>()->default_value("false")}, // Linear-space mode.
+          {"bit_parallel", "Compute only the length of the LCS, with the bit-parallel algorithm.",
+           cxxopts::value<bool>()->default_value("false")}, // Bit-parallel length-only mode.
+          {"parallel_traceback", "Trace each process's segment of the LCS in parallel.",
+           cxxopts::value<bool>()->default_value("false")}, // Parallel traceback.
+          {"stats_file", "Path to .csv file for the time and communication of each process.",
+           cxxopts::value<std::string>()->default_value("")}, // Per-process statistics.
+          {"length_only", "Compute only the length of the LCS, without storing the matrix.",
+           cxxopts::value<bool>()->default_value("false")}, // Length-only mode.
+          {"checkpoint_dir", "Directory for checkpoints, from which an interrupted run is resumed (length-only mode).",
+           cxxopts::value<std::string>()->default_value("")}, // Checkpoint directory.
+          {"checkpoint_interval", "Blocks of rows between checkpoints.",
+           cxxopts::value<int>()->default_value("100")} // Checkpoint interval.
       });
 
   auto command_options = options.parse(argc, argv);
@@ -393,19 +944,186 @@ int main(int argc, char *argv[])
   std::string sequence_a = command_options["sequence_a"].as<std::string>();
   std::string sequence_b = command_options["sequence_b"].as<std::string>();
   std::string input_file = command_options["input_file"].as<std::string>();
+  std::string batch_file = command_options["batch_file"].as<std::string>();
+  std::string output_file = command_options["output_file"].as<std::string>();
+  int chunk_size = command_options["chunk_size"].as<int>();
+  int n_threads = command_options["n_threads"].as<int>();
+  int simd_lanes = command_options["simd_lanes"].as<int>();
+  int block_rows = command_options["block_rows"].as<int>();
+  int grid_rows = command_options["grid_rows"].as<int>();
+  std::string weights_file = command_options["weights_file"].as<std::string>();
+  bool calibrate = command_options["calibrate"].as<bool>();
+  int simulate_ranks = command_options["simulate_ranks"].as<int>();
+  std::string transport_name = command_options["transport"].as<std::string>();
+  bool linear_space = command_options["linear_space"].as<bool>();
+  bool mpi_io = command_options["mpi_io"].as<bool>();
+  bool bit_parallel = command_options["bit_parallel"].as<bool>();
+  bool length_only = command_options["length_only"].as<bool>();
+  bool parallel_traceback = command_options["parallel_traceback"].as<bool>();
+  std::string stats_file = command_options["stats_file"].as<std::string>();
+  CheckpointConfig checkpoint;
+  checkpoint.directory = command_options["checkpoint_dir"].as<std::string>();
+  checkpoint.interval = command_options["checkpoint_interval"].as<int>();
+
+  if (batch_file != "" &&
+      (input_file != "" || mpi_io || linear_space || bit_parallel || grid_rows != 1 ||
+       checkpoint.directory != "" || weights_file != "" || calibrate || parallel_traceback ||
+       stats_file != ""))
+  {
+    std::cerr << "Error: batch mode only supports --output_file, --chunk_size, --n_threads, --simd_lanes and --length_only." << std::endl;
+    exit(1);
+  }
+
+  if (batch_file == "" && (n_threads != 1 || simd_lanes != 0))
+  {
+    std::cerr << "Error: --n_threads and --simd_lanes are only supported in batch mode." << std::endl;
+    exit(1);
+  }
+
+  if (n_threads < 1)
+  {
+    std::cerr << "Error: Number of threads must be greater than zero." << std::endl;
+    exit(1);
+  }
+
+  if (simd_lanes != 0 && simd_lanes != 8 && simd_lanes != 16 && simd_lanes != 32)
+  {
+    std::cerr << "Error: SIMD lanes must be 8, 16 or 32." << std::endl;
+    exit(1);
+  }
+
+  if (chunk_size < 1)
+  {
+    std::cerr << "Error: chunk size must be greater than zero." << std::endl;
+    exit(1);
+  }
 
-  if (input_file != "")
+  if (mpi_io && input_file == "")
+  {
+    std::cerr << "Error: --mpi_io requires an input file." << std::endl;
+    exit(1);
+  }
+
+  /* With MPI-IO, each process reads its own parts of the file once MPI has
+  been initialized. */
+  if (input_file != "" && !mpi_io)
   {
     // Read sequences from .csv file if file path was provided.
     read_input_csv(input_file, sequence_a, sequence_b);
   }
 
-  if (sequence_a.length() < 1 || sequence_b.length() < 1)
+  if (batch_file == "" && !mpi_io && (sequence_a.length() < 1 || sequence_b.length() < 1))
   {
     std::cerr << "Error: sequences cannot be empty." << std::endl;
     exit(1);
   }
 
+  if (block_rows < 0)
+  {
+    std::cerr << "Error: block rows cannot be negative." << std::endl;
+    exit(1);
+  }
+
+  if (grid_rows < 1)
+  {
+    std::cerr << "Error: grid rows must be at least 1." << std::endl;
+    exit(1);
+  }
+
+  BoundaryTransport boundary_transport;
+  if (!parse_boundary_transport(transport_name, boundary_transport))
+  {
+    std::cerr << "Error: unknown transport: " << transport_name << std::endl;
+    exit(1);
+  }
+
+  if (boundary_transport != BoundaryTransport::TwoSided && (linear_space || bit_parallel))
+  {
+    std::cerr << "Error: linear space and bit-parallel modes only support the two_sided transport." << std::endl;
+    exit(1);
+  }
+
+  if (parallel_traceback && (grid_rows != 1 || length_only || linear_space || bit_parallel))
+  {
+    std::cerr << "Error: parallel traceback requires a single row of processes and the full matrix." << std::endl;
+    exit(1);
+  }
+
+  if (stats_file != "" && (linear_space || bit_parallel))
+  {
+    std::cerr << "Error: per-process statistics are not collected in linear space or bit-parallel mode." << std::endl;
+    exit(1);
+  }
+
+  if (simulate_ranks < 0)
+  {
+    std::cerr << "Error: simulated ranks cannot be negative." << std::endl;
+    exit(1);
+  }
+
+  if (simulate_ranks > 0 &&
+      (mpi_io || linear_space || bit_parallel || batch_file != "" || checkpoint.directory != "" ||
+       weights_file != "" || calibrate || boundary_transport != BoundaryTransport::TwoSided))
+  {
+    std::cerr << "Error: simulated ranks only support --block_rows, --grid_rows, --length_only, --parallel_traceback and --stats_file." << std::endl;
+    exit(1);
+  }
+
+  if (simulate_ranks > 0)
+  {
+    return run_simulated_ranks(sequence_a, sequence_b, simulate_ranks, grid_rows,
+                               block_rows, length_only, parallel_traceback, stats_file);
+  }
+
+  if ((weights_file != "" || calibrate) && (linear_space || bit_parallel))
+  {
+    std::cerr << "Error: weighted partitioning cannot be combined with linear space or bit-parallel mode." << std::endl;
+    exit(1);
+  }
+
+  if (weights_file != "" && calibrate)
+  {
+    std::cerr << "Error: --weights_file and --calibrate cannot be combined." << std::endl;
+    exit(1);
+  }
+
+  // A resumed run must split the columns in exactly the same way.
+  if (calibrate && checkpoint.directory != "")
+  {
+    std::cerr << "Error: --calibrate cannot be combined with checkpoints; use --weights_file." << std::endl;
+    exit(1);
+  }
+
+  if (linear_space && grid_rows != 1)
+  {
+    std::cerr << "Error: linear space mode does not use a process grid." << std::endl;
+    exit(1);
+  }
+
+  if (bit_parallel && (grid_rows != 1 || linear_space))
+  {
+    std::cerr << "Error: bit-parallel mode cannot be combined with a process grid or linear space mode." << std::endl;
+    exit(1);
+  }
+
+  if (length_only && (linear_space || bit_parallel))
+  {
+    std::cerr << "Error: length-only mode cannot be combined with linear space or bit-parallel mode." << std::endl;
+    exit(1);
+  }
+
+  if (checkpoint.directory != "" && (!length_only || grid_rows != 1))
+  {
+    std::cerr << "Error: checkpoints require length-only mode with a single row of processes." << std::endl;
+    exit(1);
+  }
+
+  if (checkpoint.interval < 1)
+  {
+    std::cerr << "Error: checkpoint interval must be at least 1." << std::endl;
+    exit(1);
+  }
+
   MPI_Init(NULL, NULL);
 
   int world_size;
@@ -413,63 +1131,329 @@ int main(int argc, char *argv[])
   int world_rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
 
-  if (world_rank == 0)
+  if (batch_file != "")
   {
-    printf("-------------------- LCS Distributed --------------------\n");
-    printf("n_processes: %d\n\n", world_size);
+    // Only rank 0 reads the batch file and writes the results.
+    std::vector<SequencePair> pairs;
+    std::ofstream out_file;
+    int n_pairs = 0;
+    if (world_rank == 0)
+    {
+      read_input_pairs_csv(batch_file, pairs);
+      n_pairs = pairs.size();
+      if (output_file != "")
+      {
+        out_file.open(output_file);
+        if (!out_file.is_open())
+        {
+          std::cerr << "Error writing file: " << output_file << std::endl;
+          n_pairs = -1;
+        }
+      }
+    }
+    MPI_Bcast(&n_pairs, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (n_pairs < 1)
+    {
+      if (world_rank == 0 && n_pairs == 0)
+      {
+        std::cerr << "Error: batch file contains no sequence pairs." << std::endl;
+      }
+      MPI_Finalize();
+      return 1;
+    }
+    if (world_rank == 0)
+    {
+      printf("-------------------- LCS Distributed Batch --------------------\n");
+      printf("n_processes: %d\n", world_size);
+      printf("n_threads: %d\n", n_threads);
+      if (output_file == "")
+      {
+        printf("\n-_-_-_-_-_-_-_ LCS Batch Results _-_-_-_-_-_-_-\n");
+      }
+    }
+
+    LCSDistributedBatch batch(pairs, output_file != "" ? (std::ostream *)&out_file : &std::cout,
+                              world_size, world_rank, chunk_size, length_only, n_threads,
+                              simd_lanes);
+    batch.solve();
+    batch.printRankStats();
+    MPI_Finalize();
+    return 0;
   }
-  MPI_Barrier(MPI_COMM_WORLD);
 
   int length_a = sequence_a.length();
   int length_b = sequence_b.length();
 
-  const int min_n_cols_per_process = length_b / world_size;
-  const int excess = length_b % world_size;
+  InputFileMPI input;
+  if (mpi_io)
+  {
+    if (!open_input_csv_mpi(input_file, MPI_COMM_WORLD, input))
+    {
+      if (world_rank == 0)
+      {
+        std::cerr << "Error reading file: " << input_file << std::endl;
+      }
+      MPI_Finalize();
+      return 1;
+    }
+    length_a = input.length_a;
+    length_b = input.length_b;
+    if (length_a < 1 || length_b < 1)
+    {
+      if (world_rank == 0)
+      {
+        std::cerr << "Error: sequences cannot be empty." << std::endl;
+      }
+      MPI_File_close(&input.file);
+      MPI_Finalize();
+      return 1;
+    }
+  }
+
+  /* Arrange the processes in a grid of grid_rows x grid_cols blocks, where
+  each block must have at least one row. */
+  if (world_size % grid_rows != 0 || grid_rows > length_a)
+  {
+    if (world_rank == 0)
+    {
+      std::cerr << "Error: grid rows must divide the number of processes and "
+                   "cannot exceed the length of sequence A."
+                << std::endl;
+    }
+    MPI_Finalize();
+    return 1;
+  }
+  const int grid_cols = world_size / grid_rows;
+  int dims[2] = {grid_rows, grid_cols};
+  int periods[2] = {0, 0};
+  MPI_Comm grid_comm;
+  // No reordering, so that ranks in the grid are the same as in MPI_COMM_WORLD.
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid_comm);
+  int coords[2];
+  MPI_Cart_coords(grid_comm, world_rank, 2, coords);
+  MPITransport transport(grid_comm, boundary_transport);
+
+  if (world_rank == 0)
+  {
+    printf("-------------------- LCS Distributed --------------------\n");
+    printf("n_processes: %d\n", world_size);
+    printf("process grid: %d x %d\n\n", grid_rows, grid_cols);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
 
   /* We need to keep track of which columns are mapped to which processes so
   we can gather them together again at the end with MPI_Gatherv.*/
-  int *sub_str_widths = new int[world_size];
-  int *start_cols = new int[world_size];
-  for (int rank = 0; rank < world_size; rank++)
+  int *sub_str_widths = new int[grid_cols];
+  int *start_cols = new int[grid_cols];
+  if (weights_file != "" || calibrate)
+  {
+    /* Faster processes get proportionally wider strips, so that every
+    process takes about as long over each block of rows. */
+    std::vector<double> rank_weights(world_size);
+    if (calibrate)
+    {
+      double rate = measureCellRate();
+      MPI_Allgather(&rate, 1, MPI_DOUBLE, rank_weights.data(), 1, MPI_DOUBLE,
+                    MPI_COMM_WORLD);
+    }
+    else
+    {
+      int valid = 0;
+      if (world_rank == 0)
+      {
+        valid = read_rank_weights(weights_file, world_size, rank_weights);
+      }
+      MPI_Bcast(&valid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+      if (!valid)
+      {
+        if (world_rank == 0)
+        {
+          std::cerr << "Error: " << weights_file << " must hold one positive weight per process."
+                    << std::endl;
+        }
+        delete[] sub_str_widths;
+        delete[] start_cols;
+        MPI_Comm_free(&grid_comm);
+        MPI_Finalize();
+        return 1;
+      }
+      MPI_Bcast(rank_weights.data(), world_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    }
+    std::vector<double> column_weights = gridColumnWeights(grid_comm, rank_weights);
+    splitRangeWeighted(length_b, grid_cols, column_weights.data(), start_cols, sub_str_widths);
+    if (world_rank == 0)
+    {
+      printf("column widths:");
+      for (int col_block = 0; col_block < grid_cols; col_block++)
+      {
+        printf(" %d", sub_str_widths[col_block]);
+      }
+      printf("\n\n");
+    }
+  }
+  else
+  {
+    splitRange(length_b, grid_cols, start_cols, sub_str_widths);
+  }
+  std::vector<int> sub_str_heights(grid_rows);
+  std::vector<int> start_rows(grid_rows);
+  splitRange(length_a, grid_rows, start_rows.data(), sub_str_heights.data());
+
+  int start_row = start_rows[coords[0]];
+  int n_rows = sub_str_heights[coords[0]];
+  int start_col = start_cols[coords[1]];
+  int n_cols = sub_str_widths[coords[1]];
+
+  if (bit_parallel)
   {
-    int start_col, n_cols;
-    n_cols = min_n_cols_per_process;
-    if (rank < excess)
+    /* sequence_a is split between the processes in whole 64-bit words, and
+    every process goes through the whole of sequence_b. */
+    std::vector<int> start_words(world_size), n_words(world_size);
+    splitRange((length_a + 63) / 64, world_size, start_words.data(), n_words.data());
+    int start = std::min(length_a, 64 * start_words[world_rank]);
+    int end = std::min(length_a, 64 * (start_words[world_rank] + n_words[world_rank]));
+    std::string local_sequence_a;
+    if (mpi_io)
     {
-      start_col = rank * (min_n_cols_per_process + 1);
-      n_cols++;
+      local_sequence_a = read_input_slice_mpi(input, input.offset_a + start, end - start);
+      sequence_b = read_input_slice_mpi(input, input.offset_b, length_b);
+      MPI_File_close(&input.file);
     }
     else
     {
-      start_col = (rank * min_n_cols_per_process) + excess;
+      local_sequence_a = sequence_a.substr(start, end - start);
+    }
+
+    /* Each character of sequence_b is a step of the pipeline, and a word
+    costs about as much as an entry of the matrix does in the other modes. */
+    if (block_rows == 0)
+    {
+      block_rows = chooseBlockRows(sequence_b, local_sequence_a, n_words[world_rank],
+                                   world_size, transport);
+    }
+    if (world_rank == 0)
+    {
+      printf("block_rows: %d\n\n", block_rows);
+    }
+
+    LCSDistributedBitParallel lcs(local_sequence_a, sequence_b, world_size,
+                                  world_rank, block_rows);
+    lcs.print();
+    delete[] sub_str_widths;
+    delete[] start_cols;
+    MPI_Comm_free(&grid_comm);
+    MPI_Finalize();
+    return 0;
+  }
+
+  // Divide up sequence A and sequence B.
+  std::string local_sequence_a, local_sequence_b;
+  if (mpi_io)
+  {
+    local_sequence_a = read_input_slice_mpi(input, input.offset_a + start_row, n_rows);
+    local_sequence_b = read_input_slice_mpi(input, input.offset_b + start_col, n_cols);
+    // In linear-space mode the sequences are read as they are needed.
+    if (!linear_space)
+    {
+      MPI_File_close(&input.file);
     }
+  }
+  else
+  {
+    local_sequence_a = sequence_a.substr(start_row, n_rows);
+    local_sequence_b = sequence_b.substr(start_col, n_cols);
+  }
 
-    start_cols[rank] = start_col;
-    sub_str_widths[rank] = n_cols;
+  /* If a previous run with the same inputs left a committed checkpoint,
+  resume from it. The rightmost process wrote the commit file, so it reads
+  it, and the block height must be the same as before. */
+  if (checkpoint.directory != "")
+  {
+    CheckpointCommit commit = {0, 0, 0, 0, 0};
+    if (world_rank == world_size - 1 && !read_checkpoint_commit(checkpoint.directory, commit))
+    {
+      commit.generation = 0;
+    }
+    MPI_Bcast(&commit, 5, MPI_INT, world_size - 1, MPI_COMM_WORLD);
+    if (commit.generation > 0)
+    {
+      if (commit.world_size != world_size || commit.length_a != length_a ||
+          commit.length_b != length_b)
+      {
+        if (world_rank == 0)
+        {
+          std::cerr << "Error: the checkpoint in " << checkpoint.directory
+                    << " was written by a run with different inputs or a different number of processes."
+                    << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+      }
+      block_rows = commit.block_rows;
+      checkpoint.resume_generation = commit.generation;
+      if (world_rank == 0)
+      {
+        printf("Resuming from checkpoint after %d blocks of rows.\n", commit.generation);
+      }
+    }
   }
 
-  int start_col = start_cols[world_rank];
-  int n_cols = sub_str_widths[world_rank];
+  if (block_rows == 0)
+  {
+    block_rows = chooseBlockRows(local_sequence_a, local_sequence_b, n_cols, grid_cols, transport);
+  }
+  if (world_rank == 0)
+  {
+    printf("block_rows: %d\n\n", block_rows);
+  }
 
-  // Divide up sequence B.
-  std::string local_sequence_b = sequence_b.substr(start_col, n_cols);
+  if (linear_space)
+  {
+    LCSDistributedLinearSpace lcs(
+        mpi_io ? SequenceReader(input, input.offset_a) : SequenceReader(sequence_a),
+        mpi_io ? SequenceReader(input, input.offset_b) : SequenceReader(sequence_b),
+        length_a, length_b, world_size, world_rank, block_rows);
+    if (mpi_io)
+    {
+      MPI_File_close(&input.file);
+    }
+    lcs.print();
+    delete[] sub_str_widths;
+    delete[] start_cols;
+    MPI_Comm_free(&grid_comm);
+    MPI_Finalize();
+    return 0;
+  }
 
   LCSDistributed lcs(
-      sequence_a,
+      local_sequence_a,
       local_sequence_b,
       world_size,
       world_rank,
       start_cols,
       sub_str_widths,
-      sequence_b);
+      transport,
+      start_row,
+      start_col,
+      block_rows,
+      length_only,
+      checkpoint,
+      parallel_traceback);
 
   // Print solution.
   lcs.print();
 
+  bool stats_written = stats_file == "" || lcs.writePerProcessStats(stats_file);
+  if (!stats_written)
+  {
+    std::cerr << "Error writing file: " << stats_file << std::endl;
+  }
+
   delete[] sub_str_widths;
   delete[] start_cols;
+  MPI_Comm_free(&grid_comm);
 
   MPI_Finalize();
 
-  return 0;
+  return stats_written ? 0 : 1;
 }
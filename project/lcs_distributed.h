@@ -0,0 +1,1392 @@
+#ifndef _LCS_DISTRIBUTED_H_
+#define _LCS_DISTRIBUTED_H_
+
+#include <algorithm> // std::max, std::min
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+#include "lcs.h"
+#include "lcs_checkpoint.h"
+#include "lcs_solver.h"
+#include "lcs_transport.h"
+
+/* Tag used for the position of the backtrace passed between processes. */
+#define TRACE_TAG 2
+/* Tag used for the notices of committed checkpoints. */
+#define COMMIT_TAG 3
+
+/* Splits `length` elements as evenly as possible into `n_parts` contiguous
+parts, the first `length % n_parts` of which get one extra element. */
+void splitRange(const int length, const int n_parts, int *starts, int *sizes)
+{
+  const int min_size = length / n_parts;
+  const int excess = length % n_parts;
+  for (int part = 0; part < n_parts; part++)
+  {
+    sizes[part] = min_size + (part < excess ? 1 : 0);
+    starts[part] = part * min_size + std::min(part, excess);
+  }
+}
+
+/* Splits `length` elements into `n_parts` contiguous parts with sizes in
+proportion to `weights` (which must be positive), rounded so that they add up
+to `length`. Every part gets at least one element if there are enough to go
+round. */
+void splitRangeWeighted(const int length, const int n_parts, const double *weights,
+                        int *starts, int *sizes)
+{
+  double total_weight = 0.0;
+  for (int part = 0; part < n_parts; part++)
+  {
+    total_weight += weights[part];
+  }
+  const int min_size = length >= n_parts ? 1 : 0;
+  const int spare = length - min_size * n_parts;
+
+  // The spare elements left over by rounding down go to the largest remainders.
+  std::vector<double> remainders(n_parts);
+  int assigned = 0;
+  for (int part = 0; part < n_parts; part++)
+  {
+    double share = spare * weights[part] / total_weight;
+    int whole = std::min(spare - assigned, (int)share);
+    sizes[part] = min_size + whole;
+    remainders[part] = share - whole;
+    assigned += whole;
+  }
+  for (; assigned < spare; assigned++)
+  {
+    int part = std::max_element(remainders.begin(), remainders.end()) - remainders.begin();
+    sizes[part]++;
+    remainders[part] = -1.0;
+  }
+
+  starts[0] = 0;
+  for (int part = 1; part < n_parts; part++)
+  {
+    starts[part] = starts[part - 1] + sizes[part - 1];
+  }
+}
+
+/**
+ * Where the time of one process went, and how much it communicated. The
+ * times of the matrix phase are split into computing entries, waiting for
+ * boundary values from the neighbors to the left and above, and sending them
+ * on to the neighbors to the right and below. The message counts cover every
+ * point-to-point message of the process and what its boundary links actually
+ * passed, as reported by each link, but not the collectives.
+ */
+struct RankStats
+{
+  double compute_time = 0.0;   // Computing entries of the matrix.
+  double recv_wait_time = 0.0; // Blocked waiting for boundary values.
+  double send_time = 0.0;      // Sending boundary values.
+  double traceback_time = 0.0; // Reconstructing the LCS, including its messages.
+  double total_time = 0.0;
+  long long messages_sent = 0;
+  long long bytes_sent = 0;
+  long long messages_received = 0;
+  long long bytes_received = 0;
+};
+
+/* Writes the statistics of every process as a .csv file, with one line per
+rank. Returns false if the file could not be written. */
+bool write_rank_stats_csv(const std::string &stats_file_path,
+                          const std::vector<RankStats> &all_stats,
+                          const std::vector<int> &n_cols)
+{
+  std::ofstream out_file(stats_file_path);
+  if (!out_file.is_open())
+  {
+    return false;
+  }
+  out_file << "rank,n_cols,compute_time,recv_wait_time,send_time,traceback_time,"
+              "total_time,messages_sent,bytes_sent,messages_received,bytes_received\n";
+  for (int rank = 0; rank < (int)all_stats.size(); rank++)
+  {
+    const RankStats &stats = all_stats[rank];
+    out_file << rank << "," << n_cols[rank] << "," << stats.compute_time << ","
+             << stats.recv_wait_time << "," << stats.send_time << ","
+             << stats.traceback_time << "," << stats.total_time << ","
+             << stats.messages_sent << "," << stats.bytes_sent << ","
+             << stats.messages_received << "," << stats.bytes_received << "\n";
+  }
+  return out_file.good();
+}
+
+/**
+ * If the specific longest common subsequence is required, then the sub-matrices
+ * can be gathered together once all of the entries have been computed.
+ *
+ * This version of the distributed LCS implementation tries to improve the
+ * performance of the acquisition of the LCS subsequence by performing the
+ * backtrace within the local processes and then using MPI send/receive to
+ * let the next process know which index to pick up the task from.
+ *
+ * The processes are arranged in a 2D grid (created with MPI_Cart_create) of
+ * blocks of rows and blocks of columns. Each process holds only the part of
+ * the matrix for its own block, plus an extra top row and leftmost column that
+ * hold the bottom row of the block above and the rightmost column of the block
+ * to the left. With a single row of processes, this is the original
+ * decomposition into strips of columns.
+ *
+ * */
+class LCSDistributed : public LongestCommonSubsequence
+{
+protected:
+  const int world_size;
+  const int world_rank;
+
+  int lcs_length = -1; /* The length of the longest common subsequence. */
+
+  /* Need to keep track of this info globally for MPI_Gatherv(). */
+  int *start_cols;
+  int *sub_str_widths;
+
+  /* The process grid, and the ranks of the neighboring processes in it
+  (MPI_PROC_NULL where there are none). All communication goes through
+  `transport`, which is usually MPI, but can also be a set of threads standing
+  in for the processes. */
+  Transport &transport;
+  int up_rank, down_rank, left_rank, right_rank;
+  int grid_dims[2];   // Number of rows and columns of processes.
+  int grid_coords[2]; // Row and column of this process in the grid.
+  /* Offsets of the local block within the full matrix: local row i is row
+  start_row + i of the full matrix, and likewise for the columns. */
+  const int start_row;
+  const int start_col;
+
+  /* The rows are computed in blocks of `block_rows` rows. Before computing a
+  block, a process receives the values of the block's rows in the rightmost
+  column of its neighbor to the left, and once it is done it sends the values
+  of its own rightmost column on to its neighbor to the right, in a single
+  message per block rather than one per row.
+
+  The messages are non-blocking and double-buffered: the receive for the next
+  block is posted before the current block is computed, and a block's send is
+  only waited on when its buffer is needed again two blocks later. A process
+  therefore only blocks when its neighbor is genuinely behind, rather than
+  whenever the two are not exactly in step. */
+  int block_rows;
+  int n_blocks;
+
+  /* With more than one row of processes, the columns of each block of rows
+  are also cut into `n_col_tiles` tiles, which are computed in order of
+  anti-diagonals (see solveDistributed()). The bottom row of each tile of the
+  last block is sent on to the process below as soon as the tile is done, so
+  that process can start once the first tile is, rather than once the whole
+  local block is, and the rows of processes overlap as a wavefront. With a
+  single row of processes there is one tile, and the blocks are computed one
+  after another. */
+  int n_col_tiles;
+  std::vector<int> tile_first_cols; // First local column of each tile, and one past the last.
+
+  /* When only the length of the LCS is needed, the matrix is not allocated.
+  Instead, each process keeps the latest row computed in each column
+  (`previous_row`, whose entry 0 is the leftmost column), and the latest value
+  computed in each row (`edge_column`), which is in the leftmost column until
+  the row's first tile is computed, and in the rightmost column once its last
+  one is. Each tile is computed with two rolling rows of its own width. */
+  const bool length_only;
+  std::vector<int> previous_row;
+  std::vector<int> edge_column;
+  std::vector<int> rolling_rows[2];
+  /* tile_corners[t] is the entry above and to the left of the next tile to be
+  computed in column of tiles t (t > 0), which the tile to its left has
+  already overwritten in `previous_row`. */
+  std::vector<int> tile_corners;
+
+  /* With a parallel traceback (single row of processes only), each process
+  records while computing its strip, for every row of its rightmost column,
+  the row at which a backtrace entering there leaves through its leftmost
+  column (see computeTraceExits()). */
+  bool parallel_traceback;
+  std::vector<int> exit_rows;   // Exit row for each row of the rightmost column.
+  std::vector<int> trace_exits; // Two rolling rows of exit rows.
+
+  /* Checkpoints (length-only mode only). When they are enabled, each boundary
+  message carries one extra value after the boundary values: the latest
+  generation written by the sender and by every process to its left. The
+  rightmost process thereby learns when a generation is complete, commits it,
+  and then notifies the other processes, which delete their older files. */
+  const CheckpointConfig checkpoint;
+  std::unique_ptr<CheckpointWriter> checkpoint_writer;
+  int n_extra = 0;                      // Extra values per boundary message.
+  int left_durable_generation = 0;      // As last reported by the left neighbor.
+  int committed_generation = 0;         // Latest generation committed.
+  int commit_notice = 0;                // Receive buffer for commit notices.
+
+  /* The links through which the boundary values are received from the
+  neighbor to the left and sent to the neighbor to the right, as created by
+  the transport. */
+  std::unique_ptr<BoundaryLink> left_link;
+  std::unique_ptr<BoundaryLink> right_link;
+
+  /* Statistics of this process. With several threads per process, only one
+  thread receives from the left and only one sends to the right, and they
+  update separate fields. */
+  RankStats stats;
+
+  /* Point-to-point messages through the transport, counted in the stats. */
+  void sendMessage(const void *data, const int bytes, const int dest, const int tag)
+  {
+    transport.send(data, bytes, dest, tag);
+    stats.messages_sent++;
+    stats.bytes_sent += bytes;
+  }
+
+  int recvMessage(void *data, const int bytes, const int source, const int tag)
+  {
+    int sender = transport.recv(data, bytes, source, tag);
+    stats.messages_received++;
+    stats.bytes_received += bytes;
+    return sender;
+  }
+
+  int blockFirstRow(const int block)
+  {
+    return block * block_rows + 1;
+  }
+
+  int blockLastRow(const int block)
+  {
+    return std::min(blockFirstRow(block) + block_rows, matrix_height) - 1;
+  }
+
+  /* Adds what a boundary link has passed to the stats. */
+  void addLinkTraffic(const std::unique_ptr<BoundaryLink> &link)
+  {
+    if (link)
+    {
+      const LinkTraffic &traffic = link->getTraffic();
+      stats.messages_sent += traffic.messages_sent;
+      stats.bytes_sent += traffic.bytes_sent;
+      stats.messages_received += traffic.messages_received;
+      stats.bytes_received += traffic.bytes_received;
+    }
+  }
+
+  /* Frees the boundary links once every block has been exchanged. Collective,
+  so it must come after any other communication that a process could be
+  waiting on. */
+  void closeBoundaryLinks()
+  {
+    addLinkTraffic(left_link);
+    addLinkTraffic(right_link);
+    left_link.reset();
+    right_link.reset();
+    transport.closeBoundaryLinks();
+  }
+
+  /* Posts the receive for the left neighbor's rightmost column for a block. */
+  void postBoundaryReceive(const int block)
+  {
+    int count = blockLastRow(block) - blockFirstRow(block) + 1;
+    left_link->postReceive(count + n_extra);
+  }
+
+  /* Waits for the left neighbor's rightmost column for a block, and copies it
+  into the leftmost column of the local matrix. */
+  void receiveBoundary(const int block)
+  {
+    Timer wait_timer;
+    wait_timer.start();
+    const int *boundary = left_link->waitReceive();
+    stats.recv_wait_time += wait_timer.stop();
+    const int first_row = blockFirstRow(block);
+    const int last_row = blockLastRow(block);
+    if (n_extra > 0)
+    {
+      left_durable_generation = boundary[last_row - first_row + 1];
+    }
+    for (int row = first_row; row <= last_row; row++)
+    {
+      int value = boundary[row - first_row];
+      if (length_only)
+      {
+        edge_column[row] = value;
+      }
+      else
+      {
+        matrix[row][0] = value;
+      }
+    }
+    left_link->releaseReceive();
+  }
+
+  /* Starts sending the rightmost column of the local matrix for a block to
+  the neighbor to the right. */
+  void sendBoundary(const int block)
+  {
+    Timer send_timer;
+    send_timer.start();
+    int *boundary = right_link->sendBuffer();
+    const int first_row = blockFirstRow(block);
+    const int last_row = blockLastRow(block);
+    for (int row = first_row; row <= last_row; row++)
+    {
+      boundary[row - first_row] =
+          length_only ? edge_column[row] : matrix[row][matrix_width - 1];
+    }
+    if (n_extra > 0)
+    {
+      boundary[last_row - first_row + 1] = durableGeneration();
+    }
+    right_link->send(last_row - first_row + 1 + n_extra);
+    stats.send_time += send_timer.stop();
+  }
+
+  /* First local column of the part of the top or bottom row that is passed
+  between processes for a tile, which includes the leftmost column for the
+  first tile. */
+  int segmentFirstCol(const int tile)
+  {
+    return tile == 0 ? 0 : tile_first_cols[tile];
+  }
+
+  /* Unless we are in the top row of processes, the top row of a tile is the
+  bottom row of the same columns in the block above. */
+  void receiveTopSegment(const int tile)
+  {
+    if (up_rank != MPI_PROC_NULL)
+    {
+      const int first_col = segmentFirstCol(tile);
+      const int n_cols = tile_first_cols[tile + 1] - first_col;
+      int *top_row = length_only ? previous_row.data() : matrix[0];
+      Timer wait_timer;
+      wait_timer.start();
+      recvMessage(top_row + first_col, n_cols * sizeof(int), up_rank, BOUNDARY_TAG);
+      stats.recv_wait_time += wait_timer.stop();
+    }
+  }
+
+  /* Unless we are in the bottom row of processes, pass the bottom row of a
+  tile of the last block on to the block below. */
+  void sendBottomSegment(const int tile)
+  {
+    if (down_rank != MPI_PROC_NULL)
+    {
+      const int first_col = segmentFirstCol(tile);
+      const int n_cols = tile_first_cols[tile + 1] - first_col;
+      // In length-only mode the last row computed is the previous row.
+      int *bottom_row = length_only ? previous_row.data() : matrix[matrix_height - 1];
+      Timer send_timer;
+      send_timer.start();
+      sendMessage(bottom_row + first_col, n_cols * sizeof(int), down_rank, BOUNDARY_TAG);
+      stats.send_time += send_timer.stop();
+    }
+  }
+
+  /* Unless we are in the top row of processes, the top row of the local
+  matrix is the bottom row of the block above, including the entry above the
+  leftmost column. Used by subclasses that exchange whole rows rather than
+  tiles; both processes of a pair must do the same. */
+  void receiveTopBoundary()
+  {
+    if (up_rank != MPI_PROC_NULL)
+    {
+      int *top_row = length_only ? previous_row.data() : matrix[0];
+      Timer wait_timer;
+      wait_timer.start();
+      recvMessage(top_row, matrix_width * sizeof(int), up_rank, BOUNDARY_TAG);
+      stats.recv_wait_time += wait_timer.stop();
+    }
+  }
+
+  /* Unless we are in the bottom row of processes, pass our bottom row on to
+  the block below. */
+  void sendBottomBoundary()
+  {
+    if (down_rank != MPI_PROC_NULL)
+    {
+      // In length-only mode the last row computed is the previous row.
+      int *bottom_row = length_only ? previous_row.data() : matrix[matrix_height - 1];
+      Timer send_timer;
+      send_timer.start();
+      sendMessage(bottom_row, matrix_width * sizeof(int), down_rank, BOUNDARY_TAG);
+      stats.send_time += send_timer.stop();
+    }
+  }
+
+  /* Computes a tile of a block of rows. */
+  void computeTile(const int block, const int tile)
+  {
+    const int first_row = blockFirstRow(block);
+    const int last_row = blockLastRow(block);
+    const int first_col = tile_first_cols[tile];
+    const int last_col = tile_first_cols[tile + 1] - 1;
+    if (length_only)
+    {
+      computeTileLengthOnly(first_row, last_row, tile);
+      return;
+    }
+    for (int row = first_row; row <= last_row; row++)
+    {
+      for (int col = first_col; col <= last_col; col++)
+      {
+        computeCell(row, col);
+      }
+      if (parallel_traceback)
+      {
+        recordTraceExits(row); // There is only one tile per row.
+      }
+    }
+  }
+
+  /* Computes a tile in length-only mode, using the rolling rows. */
+  void computeTileLengthOnly(const int first_row, const int last_row, const int tile)
+  {
+    const int first_col = tile_first_cols[tile];
+    const int last_col = tile_first_cols[tile + 1] - 1;
+    const int width = last_col - first_col + 2; // Including the column to the left.
+    int *top = rolling_rows[0].data();
+    int *current = rolling_rows[1].data();
+    top[0] = tile == 0 ? previous_row[0] : tile_corners[tile];
+    std::copy(&previous_row[first_col], &previous_row[last_col] + 1, top + 1);
+    if (tile + 1 < n_col_tiles)
+    {
+      // The corner of the next tile to the right, before it is overwritten.
+      tile_corners[tile + 1] = previous_row[last_col];
+    }
+    for (int row = first_row; row <= last_row; row++)
+    {
+      const char a = sequence_a[row - 1];
+      const char *b = sequence_b.data() + first_col - 1;
+      current[0] = edge_column[row];
+      for (int k = 1; k < width; k++)
+      {
+        if (a == b[k - 1])
+        {
+          current[k] = top[k - 1] + 1;
+        }
+        else
+        {
+          current[k] = std::max(top[k], current[k - 1]);
+        }
+      }
+      edge_column[row] = current[width - 1];
+      std::swap(top, current);
+    }
+    if (tile == 0)
+    {
+      previous_row[0] = top[0];
+    }
+    std::copy(top + 1, top + width, &previous_row[first_col]);
+  }
+
+  /* The latest generation written by this process and every process to its
+  left. */
+  int durableGeneration()
+  {
+    int generation = checkpoint_writer->durableGeneration();
+    if (left_rank != MPI_PROC_NULL)
+    {
+      generation = std::min(generation, left_durable_generation);
+    }
+    return generation;
+  }
+
+  void commitCheckpoint(const int generation)
+  {
+    int total_length_b = 0;
+    for (int col_block = 0; col_block < grid_dims[1]; col_block++)
+    {
+      total_length_b += sub_str_widths[col_block];
+    }
+    CheckpointCommit commit = {world_size, length_a, total_length_b, block_rows, generation};
+    if (!write_checkpoint_commit(checkpoint.directory, commit))
+    {
+      std::cerr << "Warning: could not write checkpoint commit file" << std::endl;
+      return;
+    }
+    committed_generation = generation;
+    checkpoint_writer->removeBefore(generation);
+
+    sendCommitNotice(generation);
+  }
+
+  /* Lets the other processes know of a commit, or with -1 that there will be
+  no more. The notices are single values, which are sent without waiting for
+  the receiver. */
+  void sendCommitNotice(const int generation)
+  {
+    for (int rank = 0; rank < world_size - 1; rank++)
+    {
+      sendMessage(&generation, sizeof(generation), rank, COMMIT_TAG);
+    }
+  }
+
+  /* Receives the next commit notice, if one has arrived or `wait` is set,
+  and deletes this process's generations older than it. */
+  bool pollCommitNotice(const bool wait)
+  {
+    if (!wait && !transport.probe(world_size - 1, COMMIT_TAG))
+    {
+      return false;
+    }
+    recvMessage(&commit_notice, sizeof(commit_notice), world_size - 1, COMMIT_TAG);
+    if (commit_notice >= 0)
+    {
+      checkpoint_writer->removeBefore(commit_notice);
+    }
+    return true;
+  }
+
+  /* Called after each block. Queues a checkpoint every `interval` blocks,
+  and commits or cleans up the ones that are complete. */
+  void checkpointBlock(const int block)
+  {
+    if (!checkpoint_writer)
+    {
+      return;
+    }
+    const int generation = block + 1;
+    if (generation % checkpoint.interval == 0 && generation < n_blocks)
+    {
+      checkpoint_writer->write(generation, previous_row);
+    }
+    if (right_rank == MPI_PROC_NULL)
+    {
+      int durable = durableGeneration();
+      if (durable > committed_generation)
+      {
+        commitCheckpoint(durable);
+      }
+    }
+    else
+    {
+      pollCommitNotice(false);
+    }
+  }
+
+  /* Once the run is complete its checkpoints are no longer needed. The commit
+  file is removed first, so that a failure part way through leaves nothing
+  to resume from, rather than an incomplete checkpoint. */
+  void finishCheckpoints()
+  {
+    if (!checkpoint_writer)
+    {
+      return;
+    }
+    checkpoint_writer->stop();
+    if (right_rank == MPI_PROC_NULL)
+    {
+      sendCommitNotice(-1); // Final notice.
+    }
+    else
+    {
+      while (pollCommitNotice(true) && commit_notice >= 0)
+      {
+      }
+    }
+    transport.barrier();
+    if (right_rank == MPI_PROC_NULL)
+    {
+      std::remove(checkpoint_commit_path(checkpoint.directory).c_str());
+    }
+    transport.barrier();
+    checkpoint_writer->removeAll();
+  }
+
+  /* In length-only mode, the bottom-right process has the length of the LCS
+  in its last row, and every other process contributes 0. */
+  void reduceLCSLength()
+  {
+    int value = 0;
+    if (world_rank == world_size - 1)
+    {
+      value = previous_row[matrix_width - 1];
+    }
+    transport.reduceMax(&value, &lcs_length, 1, 0);
+  }
+
+  /* Waits for the outstanding sends to complete. */
+  void finishBoundarySends()
+  {
+    if (right_link)
+    {
+      Timer send_timer;
+      send_timer.start();
+      right_link->finishSends();
+      stats.send_time += send_timer.stop();
+    }
+  }
+
+  virtual void determineLongestSubsequenceLength()
+  {
+    /* Once the sub-matrices have been computed, we will need to send the
+    bottom right entry of the rightmost process to the root process. */
+    if (world_rank == world_size - 1)
+    {
+      lcs_length = LongestCommonSubsequence::getLongestSubsequenceLength();
+      sendMessage(&lcs_length, sizeof(lcs_length), 0, 0);
+    }
+    else if (world_rank == 0)
+    {
+      recvMessage(&lcs_length, sizeof(lcs_length), world_size - 1, 0);
+      matrix_time_taken = matrix_timer.stop();
+    }
+  }
+
+  /* Broadcast the length of the LCS from the rightmost process to every other
+  process.*/
+  void broadcastLCSLength()
+  {
+    if (world_rank == world_size - 1)
+    {
+      lcs_length = LongestCommonSubsequence::getLongestSubsequenceLength();
+    }
+
+    transport.broadcast(&lcs_length, sizeof(lcs_length), world_size - 1);
+  }
+
+  /* Returns the rank of the process that continues a backtrace which has
+  left the local block at `position` (a row and column of the full matrix),
+  or MPI_PROC_NULL if the backtrace is complete. */
+  int nextTraceRank(const int *position, const int index)
+  {
+    if (index < 0 || position[0] == 0 || position[1] == 0)
+    {
+      return MPI_PROC_NULL;
+    }
+    int coords[2] = {grid_coords[0], grid_coords[1]};
+    if (position[0] == start_row)
+    {
+      coords[0]--; // Continues in the block above.
+    }
+    if (position[1] == start_col)
+    {
+      coords[1]--; // Continues in the block to the left.
+    }
+    return transport.gridRank(coords[0], coords[1]);
+  }
+
+  /* Updates the exit rows for a row that has just been computed, and saves
+  the one on the rightmost column. */
+  void recordTraceExits(const int row)
+  {
+    int *previous = &trace_exits[((row - 1) % 2) * matrix_width];
+    int *current = &trace_exits[(row % 2) * matrix_width];
+    computeTraceExits(row, 1, matrix_width - 1, previous, current);
+    exit_rows[row] = current[matrix_width - 1];
+  }
+
+  /* Reconstructs the LCS by tracing every process's segment of the backtrace
+  at the same time. A process's entry row is the exit row of the process to
+  its right, which was recorded while computing the matrix, so finding all of
+  them only takes one small message per process. The segments are then
+  gathered on the root process, in order. */
+  void determineLongestCommonSubsequenceParallel()
+  {
+    int entry_row = matrix_height - 1;
+    if (right_rank != MPI_PROC_NULL)
+    {
+      recvMessage(&entry_row, sizeof(entry_row), right_rank, TRACE_TAG);
+    }
+    if (left_rank != MPI_PROC_NULL)
+    {
+      sendMessage(&exit_rows[entry_row], sizeof(int), left_rank, TRACE_TAG);
+    }
+
+    std::string segment;
+    traceSegment(entry_row, 1, matrix_width - 1, segment);
+
+    int segment_length = segment.length();
+    std::vector<int> segment_lengths(world_size), offsets(world_size);
+    transport.gather(&segment_length, sizeof(segment_length), segment_lengths.data(), 0);
+    int total_length = 0;
+    for (int rank = 0; rank < world_size; rank++)
+    {
+      offsets[rank] = total_length;
+      total_length += segment_lengths[rank];
+    }
+    std::vector<char> lcs_buffer(world_rank == 0 ? total_length : 0);
+    transport.gatherv(segment.data(), segment_length, lcs_buffer.data(),
+                      segment_lengths.data(), offsets.data(), 0);
+    if (world_rank == 0)
+    {
+      lcs_length = total_length;
+      longest_common_subsequence.assign(lcs_buffer.begin(), lcs_buffer.end());
+    }
+  }
+
+  virtual void determineLongestCommonSubsequence() override
+  {
+    if (parallel_traceback)
+    {
+      determineLongestCommonSubsequenceParallel();
+      return;
+    }
+
+    /* Each process will need to know the length of the LCS so that it can
+    allocate the necessary buffer space. */
+    broadcastLCSLength();
+
+    /* Each process records the characters it finds at their position in
+    the LCS, and the pieces are merged on the root process at the end. */
+    std::vector<unsigned char> lcs_buffer(lcs_length, 0);
+
+    /* The position of the backtrace, as a row and column of the full matrix,
+    and the index of the next character of the LCS to be found. It is passed
+    from process to process as the backtrace moves from block to block, and
+    starts at the bottom-right entry of the bottom-right process. */
+    int position[3];
+    bool has_position = world_rank == world_size - 1;
+    if (has_position)
+    {
+      position[0] = start_row + matrix_height - 1;
+      position[1] = start_col + matrix_width - 1;
+      position[2] = lcs_length - 1;
+    }
+
+    while (true)
+    {
+      if (!has_position)
+      {
+        /* Wait until the backtrace reaches this block, or is complete. */
+        recvMessage(position, sizeof(position), MPI_ANY_SOURCE, TRACE_TAG);
+        if (position[0] < 0)
+        {
+          break;
+        }
+      }
+      has_position = false;
+
+      int row = position[0] - start_row;
+      int col = position[1] - start_col;
+      int index = position[2];
+
+      int current, top, left, top_left;
+      top = left = top_left = 0;
+
+      while (row > 0 && col > 0 && index >= 0)
+      {
+        current = matrix[row][col];
+        top_left = matrix[row - 1][col - 1];
+        top = matrix[row - 1][col];
+        left = matrix[row][col - 1];
+
+        if (top_left == current)
+        {
+          // Go to entry to the top-left.
+          row--;
+          col--;
+          continue;
+        }
+
+        /* If the elements above, to the left, and diagonally to the top left
+        are all the same,  */
+        if (top_left == top && top_left == left)
+        {
+          lcs_buffer[index] = sequence_a[row - 1];
+          index--;
+          // Go to entry to the top-left.
+          row--;
+          col--;
+          continue;
+        }
+
+        /* If the entry to the top left is lower than the current entry but is
+        not equal to the entries above and to the left, then either the one
+        above or the one to the left must be the same as the current. */
+        if (top == current)
+        {
+          // Go to the entry above.
+          row--;
+          continue;
+        }
+        else
+        {
+          // If it wasn't the one above, it must be the one to the left.
+          col--;
+        }
+      }
+
+      /* Pass the backtrace on to the process whose block it has moved into,
+      or let every other process know that it is complete. */
+      position[0] = start_row + row;
+      position[1] = start_col + col;
+      position[2] = index;
+      int next_rank = nextTraceRank(position, index);
+      if (next_rank != MPI_PROC_NULL)
+      {
+        sendMessage(position, sizeof(position), next_rank, TRACE_TAG);
+        continue;
+      }
+      position[0] = -1;
+      for (int rank = 0; rank < world_size; rank++)
+      {
+        if (rank != world_rank)
+        {
+          sendMessage(position, sizeof(position), rank, TRACE_TAG);
+        }
+      }
+      break;
+    }
+
+    // Every character was found by exactly one process, and the rest are 0.
+    transport.reduceMax(lcs_buffer.data(), lcs_buffer.data(), lcs_length, 0);
+    if (world_rank == 0)
+    {
+      longest_common_subsequence.assign(lcs_buffer.begin(), lcs_buffer.end());
+    }
+  }
+
+  virtual void solveDistributed()
+  {
+    matrix_timer.start();
+    // When resuming from a checkpoint, the first blocks are already done.
+    const int first_block = checkpoint.resume_generation;
+    if (left_rank != MPI_PROC_NULL && first_block < n_blocks)
+    {
+      postBoundaryReceive(first_block);
+    }
+    /* Tile (block, tile) depends on the tiles above and to its left, so the
+    tiles are computed one anti-diagonal at a time, and from the top down
+    within each. The rightmost column of each block still comes out block by
+    block, and the bottom row tile by tile. */
+    const int n_diagonals = n_blocks - first_block + n_col_tiles - 1;
+    for (int diagonal = 0; diagonal < n_diagonals; diagonal++)
+    {
+      for (int tile = std::min(diagonal, n_col_tiles - 1); tile >= 0; tile--)
+      {
+        const int block = first_block + diagonal - tile;
+        if (block >= n_blocks)
+        {
+          break;
+        }
+        if (block == first_block)
+        {
+          receiveTopSegment(tile);
+        }
+
+        /* Unless we are the leftmost process, we need the rightmost column of
+        our neighbor to the left before computing the block. The receive for
+        the next block is posted first, so that it can arrive while this one
+        is being computed. */
+        if (tile == 0 && left_rank != MPI_PROC_NULL)
+        {
+          if (block + 1 < n_blocks)
+          {
+            postBoundaryReceive(block + 1);
+          }
+          receiveBoundary(block);
+        }
+
+        Timer compute_timer;
+        compute_timer.start();
+        computeTile(block, tile);
+        stats.compute_time += compute_timer.stop();
+
+        if (tile == n_col_tiles - 1)
+        {
+          /* Unless we are the rightmost process, pass our rightmost column on
+          to our neighbor to the right. */
+          if (right_rank != MPI_PROC_NULL)
+          {
+            sendBoundary(block);
+          }
+          checkpointBlock(block);
+        }
+        if (block == n_blocks - 1)
+        {
+          sendBottomSegment(tile);
+        }
+      }
+    }
+    finishBoundarySends();
+    finishCheckpoints();
+    closeBoundaryLinks();
+    // MPI_Barrier(MPI_COMM_WORLD);
+    matrix_time_taken = matrix_timer.stop();
+  }
+
+  virtual void solve() override
+  {
+    timer.start();
+    solveDistributed();
+    if (length_only)
+    {
+      reduceLCSLength();
+    }
+    else
+    {
+      Timer traceback_timer;
+      traceback_timer.start();
+      determineLongestCommonSubsequence();
+      stats.traceback_time = traceback_timer.stop();
+    }
+    time_taken = timer.stop();
+    stats.total_time = time_taken;
+  }
+
+  /* Used by subclasses that override part of the computation. They must call
+  solve() at the end of their own constructor instead, as their overrides are
+  not yet in effect while this constructor runs. */
+  LCSDistributed(
+      const std::string &sequence_a,
+      const std::string &sequence_b,
+      const int world_size,
+      const int world_rank,
+      int *start_cols,
+      int *sub_str_widths,
+      Transport &transport,
+      const int start_row,
+      const int start_col,
+      const int block_rows,
+      const bool length_only,
+      const CheckpointConfig &checkpoint,
+      const bool parallel_traceback,
+      const bool solve_now)
+      : LongestCommonSubsequence(sequence_a, sequence_b, !length_only),
+        world_size(world_size),
+        world_rank(world_rank),
+        start_cols(start_cols),
+        sub_str_widths(sub_str_widths),
+        transport(transport),
+        start_row(start_row),
+        start_col(start_col),
+        block_rows(std::max(1, block_rows)),
+        n_blocks((length_a + this->block_rows - 1) / this->block_rows),
+        length_only(length_only),
+        checkpoint(checkpoint)
+  {
+    transport.getGridDims(grid_dims);
+    transport.gridCoords(world_rank, grid_coords);
+    up_rank = transport.gridRank(grid_coords[0] - 1, grid_coords[1]);
+    down_rank = transport.gridRank(grid_coords[0] + 1, grid_coords[1]);
+    left_rank = transport.gridRank(grid_coords[0], grid_coords[1] - 1);
+    right_rank = transport.gridRank(grid_coords[0], grid_coords[1] + 1);
+
+    // Roughly as many tiles across as there are blocks of rows down.
+    n_col_tiles = grid_dims[0] > 1 ? std::max(1, std::min(matrix_width - 1, n_blocks)) : 1;
+    std::vector<int> tile_widths(n_col_tiles);
+    tile_first_cols.resize(n_col_tiles + 1);
+    splitRange(matrix_width - 1, n_col_tiles, tile_first_cols.data(), tile_widths.data());
+    for (int tile = 0; tile < n_col_tiles; tile++)
+    {
+      tile_first_cols[tile]++; // Column 0 holds the left neighbor's values.
+    }
+    tile_first_cols[n_col_tiles] = matrix_width;
+
+    if (length_only)
+    {
+      previous_row.assign(matrix_width, 0);
+      edge_column.assign(matrix_height, 0);
+      const int max_width = *std::max_element(tile_widths.begin(), tile_widths.end());
+      rolling_rows[0].assign(max_width + 1, 0);
+      rolling_rows[1].assign(max_width + 1, 0);
+      tile_corners.assign(n_col_tiles, 0);
+    }
+
+    this->parallel_traceback = parallel_traceback && !length_only && grid_dims[0] == 1;
+    if (this->parallel_traceback)
+    {
+      exit_rows.assign(matrix_height, 0);
+      // The row above the first row is the top row, where every trace ends.
+      trace_exits.assign(2 * matrix_width, 0);
+    }
+
+    // Checkpoints are only taken in length-only mode.
+    if (length_only && !checkpoint.directory.empty())
+    {
+      const int generation = checkpoint.resume_generation;
+      if (generation > 0 &&
+          !read_checkpoint_row(checkpoint_file_path(checkpoint.directory, world_rank, generation),
+                               previous_row))
+      {
+        std::cerr << "Error: could not read checkpoint of rank " << world_rank
+                  << " for generation " << generation << std::endl;
+        transport.abort(1);
+      }
+      checkpoint_writer.reset(new CheckpointWriter(checkpoint.directory, world_rank, generation));
+      n_extra = 1;
+      left_durable_generation = committed_generation = generation;
+    }
+    transport.openBoundaryLinks(left_rank, right_rank, this->block_rows + n_extra,
+                                left_link, right_link);
+
+    if (solve_now)
+    {
+      this->solve();
+    }
+  }
+
+public:
+  LCSDistributed(
+      const std::string &sequence_a,
+      const std::string &sequence_b,
+      const int world_size,
+      const int world_rank,
+      int *start_cols,
+      int *sub_str_widths,
+      Transport &transport,
+      const int start_row,
+      const int start_col,
+      const int block_rows = 1,
+      const bool length_only = false,
+      const CheckpointConfig &checkpoint = CheckpointConfig(),
+      const bool parallel_traceback = false)
+      : LCSDistributed(sequence_a, sequence_b, world_size, world_rank,
+                       start_cols, sub_str_widths, transport, start_row,
+                       start_col, block_rows, length_only, checkpoint,
+                       parallel_traceback, true)
+  {
+  }
+
+  virtual ~LCSDistributed()
+  {
+  }
+
+  virtual int getLongestSubsequenceLength() override
+  {
+    return lcs_length;
+  }
+
+  virtual void printInfo() override
+  {
+    if (!length_only)
+    {
+      std::cout << "Longest common subsequence: " << longest_common_subsequence << "\n";
+    }
+    printLCSLength();
+  }
+
+  void printPerProcessMatrices()
+  {
+    for (int rank = 0; rank < world_size; rank++)
+    {
+      if (rank == world_rank)
+      {
+        std::cout << "\nRank: " << world_rank << "\n";
+        printMatrix();
+      }
+      transport.barrier();
+    }
+  }
+
+  virtual void printTotalTimeTaken()
+  {
+    if (world_rank == 0)
+    {
+      printf("Total time taken: %lf\n", time_taken);
+    }
+  }
+
+  /* Gathers the statistics of every process on the root process. The result
+  is only filled in on the root. */
+  std::vector<RankStats> gatherRankStats()
+  {
+    std::vector<RankStats> all_stats(world_size);
+    transport.gather(&stats, sizeof(stats), all_stats.data(), 0);
+    return all_stats;
+  }
+
+  /* Number of columns of each process. */
+  std::vector<int> rankColumns()
+  {
+    std::vector<int> n_cols(world_size);
+    for (int rank = 0; rank < world_size; rank++)
+    {
+      n_cols[rank] = sub_str_widths[rank % grid_dims[1]];
+    }
+    return n_cols;
+  }
+
+  void printPerProcessStats()
+  {
+    std::vector<RankStats> all_stats = gatherRankStats();
+    if (world_rank != 0)
+    {
+      return;
+    }
+    std::vector<int> n_cols = rankColumns();
+    printf("rank | n_cols |  compute | recv_wait |     send | traceback |    total |"
+           " msgs_sent | bytes_sent | msgs_recv | bytes_recv\n");
+    for (int rank = 0; rank < world_size; rank++)
+    {
+      const RankStats &rank_stats = all_stats[rank];
+      printf("%4d | %6d | %8.4lf | %9.4lf | %8.4lf | %9.4lf | %8.4lf | %9lld | %10lld | %9lld | %10lld\n",
+             rank,
+             n_cols[rank],
+             rank_stats.compute_time,
+             rank_stats.recv_wait_time,
+             rank_stats.send_time,
+             rank_stats.traceback_time,
+             rank_stats.total_time,
+             rank_stats.messages_sent,
+             rank_stats.bytes_sent,
+             rank_stats.messages_received,
+             rank_stats.bytes_received);
+    }
+  }
+
+  /* Writes the statistics of every process to a .csv file on the root
+  process. Collective. Returns false on the root if the file could not be
+  written. */
+  bool writePerProcessStats(const std::string &stats_file_path)
+  {
+    std::vector<RankStats> all_stats = gatherRankStats();
+    if (world_rank != 0)
+    {
+      return true;
+    }
+    return write_rank_stats_csv(stats_file_path, all_stats, rankColumns());
+  }
+
+  virtual void print() override
+  {
+    printPerProcessStats();
+    transport.barrier();
+    if (world_rank == 0)
+    {
+      printInfo();
+      printf("\n");
+      printTimeTaken();
+    }
+    transport.barrier();
+  }
+};
+
+/**
+ * Chooses the number of rows computed between boundary messages.
+ *
+ * With blocks of B rows, a pipeline of P processes (the number of processes
+ * in each row of the process grid) takes roughly
+ * (length_a / B + P - 1) steps, each of which computes B * n_cols cells and
+ * sends one message. Taking t_c as the time to compute a cell and alpha as
+ * the latency of a message, the total time is minimized at
+ *
+ *   B = sqrt(length_a * alpha / ((P - 1) * n_cols * t_c))
+ *
+ * alpha is measured with a ping-pong between ranks 0 and 1, and t_c by timing
+ * a small local matrix on rank 0. The result is broadcast so that every
+ * process uses the same value.
+ */
+int chooseBlockRows(const std::string &sequence_a, const std::string &sequence_b,
+                    const int n_cols, const int n_stages, Transport &transport)
+{
+  const int length_a = sequence_a.length();
+  if (n_stages == 1)
+  {
+    return length_a; // No messages to amortize.
+  }
+
+  // Measure the latency of a single small message.
+  const int world_rank = transport.rank();
+  const int n_round_trips = 100;
+  int value = 0;
+  transport.barrier();
+  Timer latency_timer;
+  latency_timer.start();
+  for (int i = 0; i < n_round_trips; i++)
+  {
+    if (world_rank == 0)
+    {
+      transport.send(&value, sizeof(value), 1, BOUNDARY_TAG);
+      transport.recv(&value, sizeof(value), 1, BOUNDARY_TAG);
+    }
+    else if (world_rank == 1)
+    {
+      transport.recv(&value, sizeof(value), 0, BOUNDARY_TAG);
+      transport.send(&value, sizeof(value), 0, BOUNDARY_TAG);
+    }
+  }
+  double latency = latency_timer.stop() / (2 * n_round_trips);
+
+  int block_rows = 1;
+  if (world_rank == 0)
+  {
+    // Measure the time taken to compute a cell on a small sample.
+    std::string sample_a = sequence_a.substr(0, 512);
+    std::string sample_b = sequence_b.substr(0, 512);
+    LCSSolver solver;
+    Timer compute_timer;
+    compute_timer.start();
+    solver.solveLength(sample_a, sample_b);
+    double cell_time = compute_timer.stop() / ((double)sample_a.length() * sample_b.length());
+
+    double optimal = std::sqrt(length_a * latency /
+                               ((n_stages - 1) * std::max(1, n_cols) * std::max(cell_time, 1e-12)));
+    block_rows = (int)std::max(1.0, std::min((double)length_a, std::round(optimal)));
+  }
+  transport.broadcast(&block_rows, sizeof(block_rows), 0);
+  return block_rows;
+}
+
+/* Measures how many entries of the matrix per second this process computes,
+on a sample of random sequences, for weighted partitioning. The processes
+measure at the same time, so that ones sharing a node slow each other down
+as they will during the run. */
+double measureCellRate()
+{
+  const int sample_length = 1024;
+  std::string sample_a(sample_length, 'A');
+  std::string sample_b(sample_length, 'A');
+  const char alphabet[] = "ACGT";
+  unsigned int state = 12345;
+  for (int i = 0; i < sample_length; i++)
+  {
+    state = state * 1103515245 + 12345;
+    sample_a[i] = alphabet[(state >> 16) % 4];
+    state = state * 1103515245 + 12345;
+    sample_b[i] = alphabet[(state >> 16) % 4];
+  }
+
+  LCSSolver solver;
+  MPI_Barrier(MPI_COMM_WORLD);
+  Timer timer;
+  timer.start();
+  int n_samples = 0;
+  double elapsed = 0.0;
+  do
+  {
+    solver.solveLength(sample_a, sample_b);
+    n_samples++;
+    elapsed = timer.stop();
+  } while (elapsed < 0.1);
+  return n_samples * (double)sample_length * sample_length / elapsed;
+}
+
+/* Reads one weight per process from a file, separated by whitespace. Returns
+false if the file cannot be read, or does not hold exactly `n_ranks` positive
+weights. */
+bool read_rank_weights(const std::string &path, const int n_ranks, std::vector<double> &weights)
+{
+  std::ifstream in_file(path);
+  if (!in_file.is_open())
+  {
+    return false;
+  }
+  weights.clear();
+  double weight;
+  while (in_file >> weight)
+  {
+    if (!(weight > 0.0))
+    {
+      return false;
+    }
+    weights.push_back(weight);
+  }
+  return in_file.eof() && (int)weights.size() == n_ranks;
+}
+
+/* The weight of a column of the process grid is that of its slowest process,
+as each process of the column computes the same number of columns. */
+std::vector<double> gridColumnWeights(MPI_Comm grid_comm, const std::vector<double> &rank_weights)
+{
+  int dims[2], periods[2], coords[2];
+  MPI_Cart_get(grid_comm, 2, dims, periods, coords);
+  std::vector<double> column_weights(dims[1]);
+  for (coords[1] = 0; coords[1] < dims[1]; coords[1]++)
+  {
+    double weight = 0.0;
+    for (coords[0] = 0; coords[0] < dims[0]; coords[0]++)
+    {
+      int rank;
+      MPI_Cart_rank(grid_comm, coords, &rank);
+      weight = coords[0] == 0 ? rank_weights[rank] : std::min(weight, rank_weights[rank]);
+    }
+    column_weights[coords[1]] = weight;
+  }
+  return column_weights;
+}
+
+/* An input .csv file opened with MPI-IO, in the same format as for
+read_input_csv(). */
+struct InputFileMPI
+{
+  MPI_File file;
+  MPI_Offset offset_a; // Offset of the first character of sequence_a.
+  MPI_Offset offset_b; // Offset of the first character of sequence_b.
+  int length_a;
+  int length_b;
+};
+
+/* Opens the input file on every process of `comm` and locates the two
+sequences in it. Only the root process reads the file to find the commas,
+and the positions are broadcast to the others. Returns false if the file
+cannot be opened. */
+bool open_input_csv_mpi(const std::string &input_file_path, MPI_Comm comm,
+                        InputFileMPI &input)
+{
+  if (MPI_File_open(comm, input_file_path.c_str(), MPI_MODE_RDONLY,
+                    MPI_INFO_NULL, &input.file) != MPI_SUCCESS)
+  {
+    return false;
+  }
+
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  /* Offsets of the comma after sequence_a and of the end of sequence_b (the
+  next comma, or the end of the file, before any line breaks). */
+  long long bounds[2] = {-1, -1};
+  if (rank == 0)
+  {
+    MPI_Offset file_size;
+    MPI_File_get_size(input.file, &file_size);
+    std::vector<char> chunk(1 << 20);
+    MPI_Offset offset = 0;
+    while (offset < file_size && bounds[1] < 0)
+    {
+      int count = (int)std::min<MPI_Offset>(chunk.size(), file_size - offset);
+      MPI_File_read_at(input.file, offset, chunk.data(), count, MPI_CHAR,
+                       MPI_STATUS_IGNORE);
+      for (int i = 0; i < count && bounds[1] < 0; i++)
+      {
+        if (chunk[i] == ',')
+        {
+          (bounds[0] < 0 ? bounds[0] : bounds[1]) = offset + i;
+        }
+      }
+      offset += count;
+    }
+    if (bounds[0] < 0)
+    {
+      bounds[0] = file_size;
+    }
+    if (bounds[1] < 0)
+    {
+      bounds[1] = std::max<long long>(file_size, bounds[0] + 1);
+    }
+    // Leave out the line breaks at the end of sequence_b.
+    char tail[64];
+    while (bounds[1] > bounds[0] + 1)
+    {
+      int count = (int)std::min<long long>(sizeof(tail), bounds[1] - bounds[0] - 1);
+      MPI_File_read_at(input.file, bounds[1] - count, tail, count, MPI_CHAR,
+                       MPI_STATUS_IGNORE);
+      int kept = trim_line_break(tail, count);
+      bounds[1] -= count - kept;
+      if (kept > 0)
+      {
+        break;
+      }
+    }
+  }
+  MPI_Bcast(bounds, 2, MPI_LONG_LONG, 0, comm);
+
+  input.offset_a = 0;
+  input.length_a = bounds[0];
+  input.offset_b = bounds[0] + 1;
+  input.length_b = bounds[1] - bounds[0] - 1;
+  return true;
+}
+
+/* Reads `length` characters starting at `offset` of the input file. Must be
+called by every process of the communicator the file was opened with, as it
+is a collective read. */
+std::string read_input_slice_mpi(InputFileMPI &input, const MPI_Offset offset,
+                                 const int length)
+{
+  std::string slice(length, '\0');
+  MPI_File_read_at_all(input.file, offset, &slice[0], length, MPI_CHAR,
+                       MPI_STATUS_IGNORE);
+  return slice;
+}
+
+#endif
@@ -0,0 +1,395 @@
+
+
+#include <algorithm> // std::max, std::min
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mpi.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cxxopts.hpp"
+#include "lcs.h"
+#include "lcs_distributed.h"
+
+/**
+ * Hybrid MPI + threads LCS implementation.
+ *
+ * The matrix is divided between the processes in the same way as in
+ * LCSDistributed, but each process then divides its own strip of columns
+ * between several threads, which compute it in a wavefront in the same way
+ * as LongestCommonSubsequenceParallel. Only the leftmost thread receives the
+ * boundary values of the neighbor to the left, and only the rightmost thread
+ * sends them on to the neighbor to the right, so within a process the threads
+ * share their boundaries through memory instead of messages. This needs
+ * MPI_THREAD_MULTIPLE, as the two threads make MPI calls at the same time.
+ *
+ * The rows are synchronized between threads in the same blocks of
+ * `block_rows` rows as they are exchanged between processes.
+ */
+class LCSHybrid : public LCSDistributed
+{
+protected:
+  int numThreads;
+  std::vector<int> thread_start_cols; // First local column of each thread.
+  std::vector<int> thread_widths;     // Number of columns of each thread.
+
+  /* Number of rows completed by each thread. */
+  std::vector<std::atomic<int>> thread_rows_done;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  /* Time spent computing entries by each thread. */
+  std::vector<double> thread_compute_times;
+
+  void solveStrip(const int thread_id)
+  {
+    const int first_col = thread_start_cols[thread_id] + 1;
+    const int last_col = first_col + thread_widths[thread_id] - 1;
+    const bool leftmost = thread_id == 0;
+    const bool rightmost = thread_id == numThreads - 1;
+
+    if (leftmost && left_rank != MPI_PROC_NULL)
+    {
+      postBoundaryReceive(0);
+    }
+    for (int block = 0; block < n_blocks; block++)
+    {
+      const int first_row = blockFirstRow(block);
+      const int last_row = blockLastRow(block);
+
+      /* The leftmost thread waits for the neighboring process to the left,
+      and the others wait for the thread to their left. */
+      if (leftmost)
+      {
+        if (left_rank != MPI_PROC_NULL)
+        {
+          if (block + 1 < n_blocks)
+          {
+            postBoundaryReceive(block + 1);
+          }
+          receiveBoundary(block);
+        }
+      }
+      else if (thread_rows_done[thread_id - 1] < last_row)
+      {
+        std::unique_lock<std::mutex> ulock(mutex);
+        cv.wait(ulock, [this, thread_id, last_row]
+                { return thread_rows_done[thread_id - 1] >= last_row; });
+      }
+
+      Timer compute_timer;
+      compute_timer.start();
+      for (int row = first_row; row <= last_row; row++)
+      {
+        for (int col = first_col; col <= last_col; col++)
+        {
+          computeCell(row, col);
+        }
+      }
+      thread_compute_times[thread_id] += compute_timer.stop();
+
+      if (!rightmost)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          thread_rows_done[thread_id] = last_row;
+        }
+        cv.notify_all();
+      }
+      else if (right_rank != MPI_PROC_NULL)
+      {
+        sendBoundary(block);
+      }
+    }
+    if (rightmost)
+    {
+      finishBoundarySends();
+    }
+  }
+
+  virtual void solveDistributed() override
+  {
+    matrix_timer.start();
+    receiveTopBoundary();
+
+    thread_compute_times.assign(numThreads, 0.0);
+    if (numThreads == 1)
+    {
+      /* Only the main thread may make MPI calls unless the library provides
+      MPI_THREAD_MULTIPLE, which is not required for a single thread. */
+      solveStrip(0);
+    }
+    else
+    {
+      std::vector<std::thread> threads(numThreads);
+      for (int i = 0; i < numThreads; i++)
+      {
+        threads[i] = std::thread(&LCSHybrid::solveStrip, this, i);
+      }
+      for (int i = 0; i < numThreads; i++)
+      {
+        threads[i].join();
+      }
+    }
+
+    // The process is only as fast as its busiest thread.
+    stats.compute_time = *std::max_element(thread_compute_times.begin(),
+                                           thread_compute_times.end());
+
+    sendBottomBoundary();
+    closeBoundaryLinks();
+    matrix_time_taken = matrix_timer.stop();
+  }
+
+public:
+  LCSHybrid(
+      const std::string &sequence_a,
+      const std::string &sequence_b,
+      const int world_size,
+      const int world_rank,
+      int *start_cols,
+      int *sub_str_widths,
+      Transport &transport,
+      const int start_row,
+      const int start_col,
+      const int block_rows,
+      const int n_threads)
+      : LCSDistributed(sequence_a, sequence_b, world_size, world_rank,
+                       start_cols, sub_str_widths, transport, start_row,
+                       start_col, block_rows, false, CheckpointConfig(), false, false),
+        // No more threads than columns, but always one to relay the boundary.
+        numThreads(std::max(1, std::min(n_threads, (int)sequence_b.length()))),
+        thread_start_cols(numThreads),
+        thread_widths(numThreads),
+        thread_rows_done(numThreads)
+  {
+    splitRange(length_b, numThreads, thread_start_cols.data(), thread_widths.data());
+    for (int i = 0; i < numThreads; i++)
+    {
+      thread_rows_done[i] = 0;
+    }
+    this->solve();
+  }
+
+  virtual ~LCSHybrid()
+  {
+  }
+};
+
+int main(int argc, char *argv[])
+{
+  cxxopts::Options options("lcs_hybrid",
+                           "Hybrid MPI + threads LCS implementation.");
+
+  options.add_options(
+      "inputs",
+      {
+          {"n_threads", "Number of threads per process.",
+           cxxopts::value<int>()->default_value("1")}, // Threads per process.
+          {"sequence_a", "First input sequence.",
+           cxxopts::value<std::string>()->default_value("")}, // First input sequence
+          {"sequence_b", "Second input sequence.",
+           cxxopts::value<std::string>()->default_value("")}, // Second input sequence
+          {"input_file", "Path to input .csv file.",
+           cxxopts::value<std::string>()->default_value("")}, // Input file.
+          {"mpi_io", "Read only each process's part of the input file, with MPI-IO.",
+           cxxopts::value<bool>()->default_value("false")}, // Sliced input loading.
+          {"block_rows", "Rows computed between boundary messages (0 to choose automatically).",
+           cxxopts::value<int>()->default_value("0")}, // Row-block height.
+          {"grid_rows", "Number of rows of processes in the process grid.",
+           cxxopts::value<int>()->default_value("1")} // Process grid height.
+      });
+
+  auto command_options = options.parse(argc, argv);
+  // Retrieve the input sequences from command-line arguments.
+  int n_threads = command_options["n_threads"].as<int>();
+  std::string sequence_a = command_options["sequence_a"].as<std::string>();
+  std::string sequence_b = command_options["sequence_b"].as<std::string>();
+  std::string input_file = command_options["input_file"].as<std::string>();
+  bool mpi_io = command_options["mpi_io"].as<bool>();
+  int block_rows = command_options["block_rows"].as<int>();
+  int grid_rows = command_options["grid_rows"].as<int>();
+
+  if (n_threads < 1)
+  {
+    std::cerr << "Error: number of threads must be at least 1." << std::endl;
+    exit(1);
+  }
+
+  if (mpi_io && input_file == "")
+  {
+    std::cerr << "Error: --mpi_io requires an input file." << std::endl;
+    exit(1);
+  }
+
+  if (input_file != "" && !mpi_io)
+  {
+    // Read sequences from .csv file if file path was provided.
+    read_input_csv(input_file, sequence_a, sequence_b);
+  }
+
+  if (!mpi_io && (sequence_a.length() < 1 || sequence_b.length() < 1))
+  {
+    std::cerr << "Error: sequences cannot be empty." << std::endl;
+    exit(1);
+  }
+
+  if (block_rows < 0)
+  {
+    std::cerr << "Error: block rows cannot be negative." << std::endl;
+    exit(1);
+  }
+
+  if (grid_rows < 1)
+  {
+    std::cerr << "Error: grid rows must be at least 1." << std::endl;
+    exit(1);
+  }
+
+  int provided;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
+
+  int world_size;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  int world_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+  if (provided < MPI_THREAD_MULTIPLE && n_threads > 1)
+  {
+    if (world_rank == 0)
+    {
+      std::cerr << "Error: the MPI library does not support MPI_THREAD_MULTIPLE."
+                << std::endl;
+    }
+    MPI_Finalize();
+    return 1;
+  }
+
+  int length_a = sequence_a.length();
+  int length_b = sequence_b.length();
+
+  InputFileMPI input;
+  if (mpi_io)
+  {
+    if (!open_input_csv_mpi(input_file, MPI_COMM_WORLD, input))
+    {
+      if (world_rank == 0)
+      {
+        std::cerr << "Error reading file: " << input_file << std::endl;
+      }
+      MPI_Finalize();
+      return 1;
+    }
+    length_a = input.length_a;
+    length_b = input.length_b;
+    if (length_a < 1 || length_b < 1)
+    {
+      if (world_rank == 0)
+      {
+        std::cerr << "Error: sequences cannot be empty." << std::endl;
+      }
+      MPI_File_close(&input.file);
+      MPI_Finalize();
+      return 1;
+    }
+  }
+
+  if (world_size % grid_rows != 0 || grid_rows > length_a)
+  {
+    if (world_rank == 0)
+    {
+      std::cerr << "Error: grid rows must divide the number of processes and "
+                   "cannot exceed the length of sequence A."
+                << std::endl;
+    }
+    MPI_Finalize();
+    return 1;
+  }
+  const int grid_cols = world_size / grid_rows;
+  int dims[2] = {grid_rows, grid_cols};
+  int periods[2] = {0, 0};
+  MPI_Comm grid_comm;
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid_comm);
+  int coords[2];
+  MPI_Cart_coords(grid_comm, world_rank, 2, coords);
+  MPITransport transport(grid_comm);
+
+  if (world_rank == 0)
+  {
+    printf("-------------------- LCS Hybrid --------------------\n");
+    printf("n_processes: %d\n", world_size);
+    printf("n_threads: %d\n", n_threads);
+    printf("process grid: %d x %d\n\n", grid_rows, grid_cols);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  int *sub_str_widths = new int[grid_cols];
+  int *start_cols = new int[grid_cols];
+  splitRange(length_b, grid_cols, start_cols, sub_str_widths);
+  std::vector<int> sub_str_heights(grid_rows);
+  std::vector<int> start_rows(grid_rows);
+  splitRange(length_a, grid_rows, start_rows.data(), sub_str_heights.data());
+
+  int start_row = start_rows[coords[0]];
+  int n_rows = sub_str_heights[coords[0]];
+  int start_col = start_cols[coords[1]];
+  int n_cols = sub_str_widths[coords[1]];
+
+  // Divide up sequence A and sequence B.
+  std::string local_sequence_a, local_sequence_b;
+  if (mpi_io)
+  {
+    local_sequence_a = read_input_slice_mpi(input, input.offset_a + start_row, n_rows);
+    local_sequence_b = read_input_slice_mpi(input, input.offset_b + start_col, n_cols);
+    MPI_File_close(&input.file);
+  }
+  else
+  {
+    local_sequence_a = sequence_a.substr(start_row, n_rows);
+    local_sequence_b = sequence_b.substr(start_col, n_cols);
+  }
+
+  /* The threads of a process compute each block in parallel, so a step of
+  the pipeline between processes takes about as long as computing a block of
+  a thread's part of the strip. The block height is then capped so that the
+  pipeline between the threads fills within the first eighth of the rows. */
+  if (block_rows == 0)
+  {
+    block_rows = chooseBlockRows(local_sequence_a, local_sequence_b,
+                                 std::max(1, n_cols / n_threads), grid_cols, transport);
+    if (n_threads > 1)
+    {
+      block_rows = std::min(block_rows, std::max(1, n_rows / (8 * (n_threads - 1))));
+    }
+  }
+  if (world_rank == 0)
+  {
+    printf("block_rows: %d\n\n", block_rows);
+  }
+
+  LCSHybrid lcs(
+      local_sequence_a,
+      local_sequence_b,
+      world_size,
+      world_rank,
+      start_cols,
+      sub_str_widths,
+      transport,
+      start_row,
+      start_col,
+      block_rows,
+      n_threads);
+
+  // Print solution.
+  lcs.print();
+
+  delete[] sub_str_widths;
+  delete[] start_cols;
+  MPI_Comm_free(&grid_comm);
+
+  MPI_Finalize();
+
+  return 0;
+}
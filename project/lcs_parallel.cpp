@@ -1,15 +1,23 @@
 #include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <iostream>
 #include <mutex>
+#include <random>
 #include <string>
 #include <thread>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h> // OpenMP task-based backend
+#endif
+
 // Include necessary headers
 #include "cxxopts.hpp" // Command-line option parser library
 #include "lcs.h"       // Header file containing the LongestCommonSubsequence class
+#include "lcs_batch.h" // Batch mode for solving many pairs concurrently
+#include "lcs_profile.h" // Reading and writing autotuning profiles
 
 // ***
 //  This is the parallel version of the LCS program that calculates the longest
@@ -17,109 +25,412 @@
 //  perform computations in parallel.
 // ***
 
+// Implementations of the wavefront that the parallel solver can run on
+enum class ParallelBackend
+{
+  Threads, // std::thread workers synchronized with a condition variable
+  OpenMP   // OpenMP tasks with tile dependencies (requires -fopenmp)
+};
+
+// Options for the parallel solver
+struct ParallelConfig
+{
+  int n_threads = 1;   // Number of threads
+  int tile_height = 1; // Number of rows computed between synchronizations
+  ParallelBackend backend = ParallelBackend::Threads; // Wavefront to run
+  int block_width = 0; // Width of column blocks, 0 for one block per thread
+  bool parallel_traceback = false; // Trace blocks' segments in parallel
+  bool length_only = false; // Only compute the length, without the matrix
+};
+
 // Derived class for parallel computation of Longest Common Subsequence (LCS)
 class LongestCommonSubsequenceParallel : public LongestCommonSubsequence
 {
 protected:
   int numThreads; // Number of threads to be used for parallel computation
+  int tile_height; // Number of rows computed between synchronizations
+  ParallelBackend backend; // Implementation of the wavefront to run
   std::vector<double>
       thread_times_taken; // Vector to store the time taken by each thread
 
   double solve_time_taken; // Time taken to compute the overall LCS
+  double traceback_time_taken = 0.0; // Time taken to trace the LCS
   std::vector<Timer>
       thread_timers; // Timer objects to measure each thread's execution time
   Timer solve_timer; // Timer for the overall solve process
 
+  // The columns of the matrix are split into blocks, and block b is computed
+  // by thread b % numThreads. By default there is one contiguous block per
+  // thread; with a block width set, narrow blocks are dealt out round-robin.
+  int block_width;                 // Columns per block, or 0 for one per thread
+  std::vector<int> block_start_cols; // First column of each block
+  std::vector<int> block_end_cols;   // Last column of each block
+
   std::vector<std::atomic<int>>
-      thread_row_indices; // Atomic indices to ensure safe row updates by each
-                          // thread
+      block_row_indices; // Atomic indices of the next row to be computed in
+                         // each block
+
+  // With the parallel traceback, each block records where the backtrace
+  // leaves it for every row it could have been entered at, so that the
+  // blocks' segments of the backtrace can be traced at the same time.
+  bool parallel_traceback;
+  std::vector<std::vector<int>>
+      block_exit_rows; // Row at which a trace entering the right edge of the
+                       // block at a given row leaves through its left edge
+  std::vector<std::vector<int>>
+      block_exits; // Two rolling rows of exit rows for every column of a block
+  std::vector<std::string> block_segments; // LCS characters found in each block
+
+  // In length-only mode there is no matrix. Each block keeps two rolling
+  // rows for its own columns, and writes the value of its rightmost column
+  // for every row into a boundary column read by the block to its right.
+  // Block b writes boundary column b % numThreads, so there are only as many
+  // columns as threads: block b + numThreads cannot reach a row before block
+  // b + 1, which it waits on through the blocks in between, has read it.
+  bool length_only;
+  std::vector<std::vector<int>> block_rows; // Two rolling rows per block
+  std::vector<std::vector<int>>
+      boundary_columns; // Rightmost column of the latest block of each thread
+  int lcs_length = 0;   // Length of the LCS in length-only mode
 
   std::condition_variable
       cv;           // Condition variable used for thread synchronization
   std::mutex mutex; // Mutex to protect the condition variable and ensure safe
                     // synchronization
 
-  // Function executed by each thread to compute the LCS for a portion of the
-  // matrix
-  void solveParallel(int thread_id)
+  // Splits the columns of the matrix into blocks
+  void partitionColumns()
   {
-    thread_timers[thread_id].start(); // Start the timer for the current thread
+    block_start_cols.clear();
+    block_end_cols.clear();
+    if (block_width > 0)
+    {
+      // Narrow blocks of equal width, the last one possibly narrower
+      for (int start_col = 1; start_col < matrix_width; start_col += block_width)
+      {
+        block_start_cols.push_back(start_col);
+        block_end_cols.push_back(
+            std::min(start_col + block_width, matrix_width) - 1);
+      }
+    }
+    else
+    {
+      int min_cols_per_thread =
+          length_b / numThreads; // Minimum columns per thread
+      int excess_cols =
+          length_b %
+          numThreads; // Extra columns that can't be evenly distributed
+
+      for (int thread_id = 0; thread_id < numThreads; thread_id++)
+      {
+        int start_col;
+        int n_cols = min_cols_per_thread;
+        if (thread_id < excess_cols)
+        {
+          start_col =
+              thread_id * (min_cols_per_thread +
+                           1); // Assign extra column to threads with a smaller ID
+          n_cols++;
+        }
+        else
+        {
+          start_col = (thread_id * min_cols_per_thread) +
+                      excess_cols; // Distribute the remaining columns evenly
+        }
+        start_col +=
+            1; // Offset by 1 because the first column is initialized to zero
+        block_start_cols.push_back(start_col);
+        block_end_cols.push_back(std::min(
+            start_col + n_cols - 1,
+            matrix_width - 1)); // Calculate the ending column for the thread
+      }
+    }
+    block_row_indices = std::vector<std::atomic<int>>(block_start_cols.size());
+  }
 
-    int min_cols_per_thread =
-        length_b / numThreads; // Minimum columns per thread
-    int excess_cols =
-        length_b %
-        numThreads; // Extra columns that can't be evenly distributed
+  // Computes every cell of a tile of the matrix
+  void computeTile(int block, int first_row, int last_row)
+  {
+    if (length_only)
+    {
+      computeTileLengthOnly(block, first_row, last_row);
+      return;
+    }
+    int start_col = block_start_cols[block];
+    int end_col = block_end_cols[block];
+    for (int row = first_row; row <= last_row; row++)
+    {
+      for (int col = start_col; col <= end_col; col++)
+      {
+        computeCell(row, col); // Compute the LCS value for the current cell
+      }
+      if (parallel_traceback)
+      {
+        recordTraceExits(block, row);
+      }
+    }
+  }
 
-    int start_col;
-    int n_cols = min_cols_per_thread;
-    if (thread_id < excess_cols)
+  // Computes the rows of a tile using the block's rolling rows. Entry k of a
+  // rolling row is column start_col - 1 + k, so entry 0 holds the value of the
+  // left neighbor's boundary column. The cells follow computeCell().
+  void computeTileLengthOnly(int block, int first_row, int last_row)
+  {
+    int start_col = block_start_cols[block];
+    int width = std::max(0, block_end_cols[block] - start_col + 1);
+    const char *b = sequence_b.data() + start_col - 1;
+    const int *left_boundary =
+        block > 0 ? boundary_columns[(block - 1) % numThreads].data() : nullptr;
+    int *boundary = boundary_columns[block % numThreads].data();
+    for (int row = first_row; row <= last_row; row++)
     {
-      start_col =
-          thread_id * (min_cols_per_thread +
-                       1); // Assign extra column to threads with a smaller ID
-      n_cols++;
+      const int *top = &block_rows[block][((row - 1) % 2) * (width + 1)];
+      int *current = &block_rows[block][(row % 2) * (width + 1)];
+      current[0] = block > 0 ? left_boundary[row] : 0;
+      char a = sequence_a[row - 1];
+      for (int k = 1; k <= width; k++)
+      {
+        if (a == b[k - 1])
+        {
+          current[k] = top[k - 1] + 1;
+        }
+        else
+        {
+          current[k] = std::max(top[k], current[k - 1]);
+        }
+      }
+      boundary[row] = current[width];
+    }
+  }
+
+  // Allocates the rolling rows and boundary columns for length-only mode
+  void prepareLengthOnly()
+  {
+    int n_blocks = block_start_cols.size();
+    block_rows.assign(n_blocks, std::vector<int>());
+    for (int block = 0; block < n_blocks; block++)
+    {
+      int width = std::max(0, block_end_cols[block] - block_start_cols[block] + 1);
+      // The row above the first row is the top row of 0s.
+      block_rows[block].assign(2 * (width + 1), 0);
+    }
+    boundary_columns.assign(numThreads, std::vector<int>(matrix_height, 0));
+  }
+
+  // Updates the exit rows of a block for a row that has just been computed,
+  // and saves the one on the block's right edge
+  void recordTraceExits(int block, int row)
+  {
+    int width = block_end_cols[block] - block_start_cols[block] + 1;
+    int *previous = &block_exits[block][((row - 1) % 2) * (width + 1)];
+    int *current = &block_exits[block][(row % 2) * (width + 1)];
+    computeTraceExits(row, block_start_cols[block], block_end_cols[block],
+                      previous, current);
+    block_exit_rows[block][row] = current[width];
+  }
+
+  // Allocates the exit rows recorded during the computation of the matrix
+  void prepareTraceExits()
+  {
+    int n_blocks = block_start_cols.size();
+    block_exit_rows.assign(n_blocks, std::vector<int>());
+    block_exits.assign(n_blocks, std::vector<int>());
+    for (int block = 0; block < n_blocks; block++)
+    {
+      int width = std::max(0, block_end_cols[block] - block_start_cols[block] + 1);
+      block_exit_rows[block].assign(matrix_height, 0);
+      // The row above the first row is the top row, where every trace ends.
+      block_exits[block].assign(2 * (width + 1), 0);
+    }
+  }
+
+  // Traces the blocks owned by a thread, starting from the given entry rows
+  void traceBlocks(int thread_id, const std::vector<int> &entry_rows)
+  {
+    int n_blocks = block_start_cols.size();
+    for (int block = thread_id; block < n_blocks; block += numThreads)
+    {
+      block_segments[block].clear();
+      traceSegment(entry_rows[block], block_start_cols[block],
+                   block_end_cols[block], block_segments[block]);
+    }
+  }
+
+  // Reconstructs the LCS by tracing every block's segment of the backtrace
+  // at the same time. Each block's entry row is the exit row of the block to
+  // its right, which was recorded during the computation of the matrix, so
+  // finding all of them takes one lookup per block.
+  void determineLongestCommonSubsequenceParallel()
+  {
+    int n_blocks = block_start_cols.size();
+    std::vector<int> entry_rows(n_blocks);
+    entry_rows[n_blocks - 1] = matrix_height - 1;
+    for (int block = n_blocks - 1; block > 0; block--)
+    {
+      entry_rows[block - 1] = block_exit_rows[block][entry_rows[block]];
+    }
+
+    block_segments.assign(n_blocks, std::string());
+#ifdef _OPENMP
+    if (backend == ParallelBackend::OpenMP)
+    {
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+      for (int block = 0; block < n_blocks; block++)
+      {
+        traceSegment(entry_rows[block], block_start_cols[block],
+                     block_end_cols[block], block_segments[block]);
+      }
     }
     else
+#endif
     {
-      start_col = (thread_id * min_cols_per_thread) +
-                  excess_cols; // Distribute the remaining columns evenly
+      std::vector<std::thread> threads(numThreads);
+      for (int i = 0; i < numThreads; i++)
+      {
+        threads[i] = std::thread(&LongestCommonSubsequenceParallel::traceBlocks,
+                                 this, i, std::cref(entry_rows));
+      }
+      for (int i = 0; i < numThreads; i++)
+      {
+        threads[i].join();
+      }
     }
-    start_col +=
-        1; // Offset by 1 because the first column is initialized to zero
-    int end_col = std::min(
-        start_col + n_cols - 1,
-        matrix_width - 1); // Calculate the ending column for the thread
 
-    int row, col;
-    thread_row_indices[thread_id] = 1; // Set initial row index for the thread
-    for (row = 1; row < matrix_height; row++)
+    // The segments are in order from left to right.
+    longest_common_subsequence.clear();
+    for (int block = 0; block < n_blocks; block++)
     {
-      // If this is not the leftmost thread, wait until the thread to the left
-      // finishes processing the row
-      if (thread_id > 0)
+      longest_common_subsequence += block_segments[block];
+    }
+  }
+
+  // Computes a block of columns from top to bottom, one tile of rows at a
+  // time, synchronizing with the block to its left once per tile
+  void solveBlock(int block)
+  {
+    for (int tile_row = 1; tile_row < matrix_height; tile_row += tile_height)
+    {
+      int last_row = std::min(tile_row + tile_height, matrix_height) - 1;
+
+      // If this is not the leftmost block, wait until the block to the left
+      // has finished the rows of this tile
+      if (block > 0)
       {
-        if (thread_row_indices[thread_id - 1] <= row)
+        if (block_row_indices[block - 1] <= last_row)
         {
           std::unique_lock<std::mutex> ulock(
               mutex); // Lock the mutex to protect shared data
-          // Wait until the thread on the left is done with the current row
-          cv.wait(ulock, [this, &thread_id, &row]
-                  { return thread_row_indices[thread_id - 1] > row; });
+          // Wait until the block on the left is done with the current tile
+          cv.wait(ulock, [this, &block, &last_row]
+                  { return block_row_indices[block - 1] > last_row; });
           ulock.unlock(); // Unlock after waiting
         }
       }
 
-      // Once the left neighbor is done, process the current row for the
-      // assigned columns
-      for (col = start_col; col <= end_col; col++)
+      // Once the left neighbor is done, process the rows of the tile
+      computeTile(block, tile_row, last_row);
+
       {
-        computeCell(row, col); // Compute the LCS value for the current cell
+        // Update the row index for this block. The mutex is held so that a
+        // neighbor cannot miss the notification between checking the index
+        // and starting to wait.
+        std::lock_guard<std::mutex> lock(mutex);
+        block_row_indices[block] = last_row + 1;
       }
 
-      thread_row_indices[thread_id] +=
-          1; // Update the row index for this thread
-
       // Notify other threads that they can wake up and continue processing
       cv.notify_all();
     }
+  }
+
+  // Function executed by each thread to compute the LCS for a portion of the
+  // matrix
+  void solveParallel(int thread_id)
+  {
+    thread_timers[thread_id].start(); // Start the timer for the current thread
+
+    // Each block the thread owns is finished before it moves on to the next
+    // one. By the time a thread reaches its next block, the block to its left
+    // has long since started, so the threads never wait on each other after
+    // the pipeline has filled.
+    int n_blocks = block_start_cols.size();
+    for (int block = thread_id; block < n_blocks; block += numThreads)
+    {
+      solveBlock(block);
+    }
 
     thread_times_taken[thread_id] =
         thread_timers[thread_id]
             .stop(); // Stop the timer for the current thread
   }
 
+#ifdef _OPENMP
+  // Computes the matrix with one OpenMP task per tile. Tiles are the same
+  // blocks of columns as the threads backend, cut into `tile_height` rows.
+  // Each task depends on the tile above it and the tile to its left, so the
+  // runtime schedules the tiles as a wavefront.
+  void solveOpenMP()
+  {
+    int n_tile_rows = (length_a + tile_height - 1) / tile_height;
+    int n_blocks = block_start_cols.size();
+    // One dependency token per tile. Only their addresses are used.
+    std::vector<char> tile_tokens((size_t)n_tile_rows * n_blocks);
+    char *tokens = tile_tokens.data();
+
+#pragma omp parallel num_threads(numThreads)
+    {
+      thread_timers[omp_get_thread_num()].start();
+
+#pragma omp single
+      {
+        for (int tile_row = 0; tile_row < n_tile_rows; tile_row++)
+        {
+          int first_row = tile_row * tile_height + 1;
+          int last_row = std::min(first_row + tile_height, matrix_height) - 1;
+          for (int block = 0; block < n_blocks; block++)
+          {
+            char *tile = &tokens[(size_t)tile_row * n_blocks + block];
+            // Tiles on the top row or the leftmost block depend on themselves
+            // in place of the missing neighbor.
+            char *top = tile_row > 0 ? tile - n_blocks : tile;
+            char *left = block > 0 ? tile - 1 : tile;
+            // Only used by the depend clause, which GCC does not count as a use.
+            (void)top;
+            (void)left;
+
+#pragma omp task firstprivate(first_row, last_row, block) \
+    depend(in : top[0], left[0]) depend(out : tile[0])
+            {
+              computeTile(block, first_row, last_row);
+            }
+          }
+        }
+      }
+
+      thread_times_taken[omp_get_thread_num()] =
+          thread_timers[omp_get_thread_num()].stop();
+    }
+  }
+#endif
+
 public:
-  // Constructor that initializes the LCS solver with the sequences and number
-  // of threads
-  LongestCommonSubsequenceParallel(const std::string &sequence_a,
-                                   const std::string &sequence_b, int threads)
-      : LongestCommonSubsequence(sequence_a, sequence_b),
-        numThreads(std::max(1, threads)), // Ensure at least one thread
+  // Constructor that initializes the LCS solver with the sequences and the
+  // options for the parallel computation. The full matrix is not allocated
+  // in length-only mode.
+  LongestCommonSubsequenceParallel(const SequenceView &sequence_a,
+                                   const SequenceView &sequence_b,
+                                   const ParallelConfig &config)
+      : LongestCommonSubsequence(sequence_a, sequence_b, !config.length_only),
+        numThreads(std::max(1, config.n_threads)), // Ensure at least one thread
+        tile_height(std::max(1, config.tile_height)),
+        backend(config.backend),
         thread_times_taken(numThreads, 0.0),
         thread_timers(numThreads),
-        thread_row_indices(numThreads)
+        block_width(std::max(0, config.block_width)),
+        parallel_traceback(config.parallel_traceback && !config.length_only),
+        length_only(config.length_only)
   {
+    partitionColumns();
   }
 
   // Override the solve method to compute the LCS in parallel using threads
@@ -127,25 +438,81 @@ public:
   {
     solve_timer.start(); // Start the overall timer for LCS computation
 
-    // Launch a vector of threads to perform parallel LCS computation
-    std::vector<std::thread> threads(numThreads);
-    for (int i = 0; i < numThreads; i++)
+    if (parallel_traceback)
+    {
+      prepareTraceExits();
+    }
+    if (length_only)
     {
-      threads[i] = std::thread(&LongestCommonSubsequenceParallel::solveParallel,
-                               this, i); // Start each thread
+      prepareLengthOnly();
     }
 
-    // Wait for all threads to finish their work
-    for (int i = 0; i < numThreads; i++)
+#ifdef _OPENMP
+    if (backend == ParallelBackend::OpenMP)
     {
-      threads[i].join(); // Join each thread to ensure they all complete before
-                         // proceeding
+      solveOpenMP();
+    }
+    else
+#endif
+    {
+      // Launch a vector of threads to perform parallel LCS computation
+      std::vector<std::thread> threads(numThreads);
+      for (int i = 0; i < numThreads; i++)
+      {
+        threads[i] = std::thread(&LongestCommonSubsequenceParallel::solveParallel,
+                                 this, i); // Start each thread
+      }
+
+      // Wait for all threads to finish their work
+      for (int i = 0; i < numThreads; i++)
+      {
+        threads[i].join(); // Join each thread to ensure they all complete
+                           // before proceeding
+      }
     }
 
     solve_time_taken = solve_timer.stop(); // Stop the overall timer
 
+    if (length_only)
+    {
+      // The bottom entry of the rightmost block's boundary column is the
+      // bottom-right entry of the matrix.
+      int n_blocks = block_start_cols.size();
+      lcs_length = boundary_columns[(n_blocks - 1) % numThreads][matrix_height - 1];
+      return;
+    }
+
     // After all threads have finished, determine the LCS based on the matrix
-    determineLongestCommonSubsequence();
+    Timer traceback_timer;
+    traceback_timer.start();
+    if (parallel_traceback)
+    {
+      determineLongestCommonSubsequenceParallel();
+    }
+    else
+    {
+      determineLongestCommonSubsequence();
+    }
+    traceback_time_taken = traceback_timer.stop();
+  }
+
+  virtual int getLongestSubsequenceLength() override
+  {
+    if (length_only)
+    {
+      return lcs_length;
+    }
+    return LongestCommonSubsequence::getLongestSubsequenceLength();
+  }
+
+  virtual void printInfo() override
+  {
+    if (length_only)
+    {
+      printLCSLength();
+      return;
+    }
+    LongestCommonSubsequence::printInfo();
   }
 
   // Print statistics related to each thread's execution time
@@ -161,9 +528,72 @@ public:
     printf(
         "Solve Time Taken: %f\n",
         solve_time_taken); // Print the total time for solving the LCS problem
+    printf("Traceback Time Taken: %f\n", traceback_time_taken);
   }
 };
 
+// Times short calibration runs of the parallel solver on random sequences for
+// every combination of length, thread count and tile height, and returns the
+// average time of each combination.
+std::vector<ProfileEntry> autotune(int max_length, int max_threads, int n_runs)
+{
+  std::vector<int> lengths;
+  for (int length = 100; length < max_length; length *= 10)
+  {
+    lengths.push_back(length);
+  }
+  lengths.push_back(max_length);
+
+  std::vector<int> thread_counts;
+  for (int n_threads = 1; n_threads < max_threads; n_threads *= 2)
+  {
+    thread_counts.push_back(n_threads);
+  }
+  thread_counts.push_back(max_threads);
+
+  const std::vector<int> tile_heights = {1, 8, 32, 128};
+
+  std::mt19937 generator(431); // Fixed seed so calibration runs are repeatable
+  std::uniform_int_distribution<int> distribution(0, 3);
+  const char alphabet[] = "ACGT";
+
+  std::vector<ProfileEntry> entries;
+  for (int length : lengths)
+  {
+    std::string sequence_a(length, ' ');
+    std::string sequence_b(length, ' ');
+    for (int i = 0; i < length; i++)
+    {
+      sequence_a[i] = alphabet[distribution(generator)];
+      sequence_b[i] = alphabet[distribution(generator)];
+    }
+
+    for (int n_threads : thread_counts)
+    {
+      for (int tile_height : tile_heights)
+      {
+        double time = 0.0;
+        for (int run = 0; run < n_runs; run++)
+        {
+          ParallelConfig config;
+          config.n_threads = n_threads;
+          config.tile_height = tile_height;
+          LongestCommonSubsequenceParallel lcs(SequenceView(sequence_a),
+                                               SequenceView(sequence_b), config);
+          Timer run_timer;
+          run_timer.start();
+          lcs.solve();
+          time += run_timer.stop();
+        }
+        time /= n_runs;
+        entries.push_back({length, n_threads, tile_height, time});
+        printf("%6d | %9d | %11d | %lf\n", length, n_threads, tile_height, time);
+      }
+    }
+  }
+  return entries;
+}
+
 int main(int argc, char *argv[])
 {
   Timer program_timer; // Timer for measuring total program execution time
@@ -181,12 +611,40 @@ int main(int argc, char *argv[])
       {
           {"n_threads", "Number of threads for the program",
            cxxopts::value<int>()->default_value("1")}, // Default to 1 thread
+          {"tile_height", "Number of rows computed between synchronizations",
+           cxxopts::value<int>()->default_value("1")}, // Default to 1 row
+          {"backend", "Wavefront implementation: threads or openmp",
+           cxxopts::value<std::string>()->default_value("threads")}, // Backend
+          {"block_width", "Width of column blocks dealt round-robin to threads (0 for one block per thread)",
+           cxxopts::value<int>()->default_value("0")}, // Default to one block per thread
+          {"parallel_traceback", "Trace each block's segment of the LCS in parallel",
+           cxxopts::value<bool>()->default_value("false")}, // Default to serial traceback
+          {"length_only", "Only compute the length of the LCS, using rolling rows instead of the full matrix",
+           cxxopts::value<bool>()->default_value("false")}, // Default to computing the LCS
           {"sequence_a", "First input sequence.",
            cxxopts::value<std::string>()->default_value("")}, // First input sequence
           {"sequence_b", "Second input sequence.",
            cxxopts::value<std::string>()->default_value("")}, // Second input sequence
           {"input_file", "Path to input .csv file.",
-           cxxopts::value<std::string>()->default_value("")} // Input file.
+           cxxopts::value<std::string>()->default_value("")}, // Input file.
+          {"mmap", "Map the input file into memory instead of reading it into strings.",
+           cxxopts::value<bool>()->default_value("false")}, // Memory-mapped input.
+          {"batch_file", "Path to .csv file containing one pair of sequences per line.",
+           cxxopts::value<std::string>()->default_value("")}, // Batch input file.
+          {"output_file", "Path to .csv file to write batch results to.",
+           cxxopts::value<std::string>()->default_value("")}, // Batch output file.
+          {"chunk_size", "Number of pairs claimed by a thread at a time in batch mode.",
+           cxxopts::value<int>()->default_value("1")}, // Batch chunk size.
+          {"simd_lanes", "Solve batch lengths with one pair per SIMD lane (8, 16 or 32).",
+           cxxopts::value<int>()->default_value("0")}, // SIMD lanes, 0 disables.
+          {"autotune", "Time calibration runs and write the results to the profile file.",
+           cxxopts::value<bool>()->default_value("false")}, // Autotuning mode.
+          {"autotune_max_length", "Longest sequence length used for calibration runs.",
+           cxxopts::value<int>()->default_value("5000")}, // Autotuning length.
+          {"autotune_runs", "Number of calibration runs per configuration.",
+           cxxopts::value<int>()->default_value("3")}, // Autotuning runs.
+          {"profile_file", "Path to profile .csv file used to pick the number of threads and tile height.",
+           cxxopts::value<std::string>()->default_value("")} // Profile file.
 
       });
 
@@ -194,38 +652,189 @@ int main(int argc, char *argv[])
   auto command_options = options.parse(argc, argv);
   int n_threads = command_options["n_threads"]
                       .as<int>(); // Get the number of threads from user input
+  int tile_height = command_options["tile_height"].as<int>();
+  std::string backend_name = command_options["backend"].as<std::string>();
+  int block_width = command_options["block_width"].as<int>();
+  bool parallel_traceback = command_options["parallel_traceback"].as<bool>();
+  bool length_only = command_options["length_only"].as<bool>();
 
   // Retrieve the input sequences from command-line arguments.
   std::string sequence_a = command_options["sequence_a"].as<std::string>();
   std::string sequence_b = command_options["sequence_b"].as<std::string>();
   std::string input_file = command_options["input_file"].as<std::string>();
+  bool use_mmap = command_options["mmap"].as<bool>();
+  std::string batch_file = command_options["batch_file"].as<std::string>();
+  std::string output_file = command_options["output_file"].as<std::string>();
+  int chunk_size = command_options["chunk_size"].as<int>();
+  int simd_lanes = command_options["simd_lanes"].as<int>();
+  bool autotune_mode = command_options["autotune"].as<bool>();
+  std::string profile_file = command_options["profile_file"].as<std::string>();
+
+  if (autotune_mode)
+  {
+    int max_length = command_options["autotune_max_length"].as<int>();
+    int n_runs = command_options["autotune_runs"].as<int>();
+    if (max_length < 1 || n_runs < 1)
+    {
+      std::cerr << "Error: autotuning length and runs must be greater than zero.\n";
+      return 1;
+    }
+    if (profile_file == "")
+    {
+      profile_file = "lcs_parallel_profile.csv";
+    }
+    int max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    printf("_-_-_-_-_-_-_-_-_ LCS Parallel Autotune _-_-_-_-_-_-_-_-_\n");
+    printf("length | n_threads | tile_height | time\n");
+    std::vector<ProfileEntry> entries = autotune(max_length, max_threads, n_runs);
+    write_profile_csv(profile_file, entries);
+    printf("Profile written to: %s\n", profile_file.c_str());
+    return 0;
+  }
 
-  if (input_file != "")
+  // Validate that the number of threads is positive
+  if (n_threads <= 0)
   {
-    // Read sequences from .csv file if file path was provided.
-    read_input_csv(input_file, sequence_a, sequence_b);
+    std::cerr << "Error: Number of threads must be greater than zero.\n";
+    return 1;
   }
 
-  if (sequence_a.length() < 1 || sequence_b.length() < 1)
+  if (batch_file != "")
+  {
+    // Batch mode: solve every pair in the file, one pair per thread at a time.
+    std::vector<SequencePair> pairs;
+    read_input_pairs_csv(batch_file, pairs);
+    if (pairs.empty())
+    {
+      std::cerr << "Error: batch file contains no sequence pairs." << std::endl;
+      exit(1);
+    }
+    if (chunk_size <= 0)
+    {
+      std::cerr << "Error: chunk size must be greater than zero.\n";
+      return 1;
+    }
+    if (simd_lanes != 0 && simd_lanes != 8 && simd_lanes != 16 && simd_lanes != 32)
+    {
+      std::cerr << "Error: SIMD lanes must be 8, 16 or 32.\n";
+      return 1;
+    }
+
+    printf("_-_-_-_-_-_-_-_-_ LCS Parallel Batch _-_-_-_-_-_-_-_-_\n");
+    printf("Number of Threads: %d\n", n_threads);
+
+    LongestCommonSubsequenceBatch batch(pairs, n_threads, chunk_size, simd_lanes);
+    batch.solve();
+    total_time_taken = program_timer.stop();
+
+    if (output_file != "")
+    {
+      batch.writeResults(output_file);
+    }
+    else
+    {
+      printf("\n-_-_-_-_-_-_-_ LCS Batch Results _-_-_-_-_-_-_-\n");
+      batch.writeResults(std::cout);
+    }
+    batch.printThreadStats();
+    printf("Total time taken: %lf\n", total_time_taken);
+    return 0;
+  }
+
+  /* The solver works on views of the sequences, either of the strings read
+  here or of the mapped file, so they are never copied again. */
+  MappedInput mapped_input;
+  SequenceView view_a, view_b;
+  if (input_file != "" && use_mmap)
+  {
+    map_input_csv(input_file, mapped_input);
+    view_a = mapped_input.sequence_a;
+    view_b = mapped_input.sequence_b;
+  }
+  else
+  {
+    if (input_file != "")
+    {
+      // Read sequences from .csv file if file path was provided.
+      read_input_csv(input_file, sequence_a, sequence_b);
+    }
+    view_a = SequenceView(sequence_a);
+    view_b = SequenceView(sequence_b);
+  }
+
+  if (view_a.length() < 1 || view_b.length() < 1)
   {
     std::cerr << "Error: sequences cannot be empty." << std::endl;
     exit(1);
   }
 
-  // Validate that the number of threads is positive
-  if (n_threads <= 0)
+  if (profile_file != "")
   {
-    std::cerr << "Error: Number of threads must be greater than zero.\n";
+    // Pick the configuration that was fastest for inputs of this size.
+    std::vector<ProfileEntry> entries;
+    read_profile_csv(profile_file, entries);
+    int length = (int)std::sqrt((double)view_a.length() * view_b.length());
+    ProfileEntry entry = select_profile_entry(entries, length);
+    n_threads = entry.n_threads;
+    tile_height = entry.tile_height;
+    printf("Using profile entry for length %d from: %s\n", entry.length,
+           profile_file.c_str());
+  }
+
+  if (tile_height <= 0)
+  {
+    std::cerr << "Error: Tile height must be greater than zero.\n";
+    return 1;
+  }
+
+  if (block_width < 0)
+  {
+    std::cerr << "Error: Block width cannot be negative.\n";
+    return 1;
+  }
+
+  if (parallel_traceback && length_only)
+  {
+    std::cerr << "Error: --parallel_traceback cannot be combined with "
+                 "--length_only.\n";
+    return 1;
+  }
+
+  ParallelBackend backend = ParallelBackend::Threads;
+  if (backend_name == "openmp")
+  {
+#ifdef _OPENMP
+    backend = ParallelBackend::OpenMP;
+#else
+    std::cerr << "Error: openmp backend requires building with OpenMP "
+                 "(make lcs_parallel_omp).\n";
+    return 1;
+#endif
+  }
+  else if (backend_name != "threads")
+  {
+    std::cerr << "Error: Unknown backend: " << backend_name << "\n";
     return 1;
   }
 
   // Print basic information about the parallel LCS run
   printf("_-_-_-_-_-_-_-_-_ LCS Parallel _-_-_-_-_-_-_-_-_\n");
   printf("Number of Threads: %d\n", n_threads);
+  printf("Tile Height: %d\n", tile_height);
+  printf("Backend: %s\n", backend_name.c_str());
+  printf("Block Width: %d\n", block_width);
   printf("Initializing Parallel Solver\n");
 
   // Create and solve the LCS problem with the specified number of threads
-  LongestCommonSubsequenceParallel lcs(sequence_a, sequence_b, n_threads);
+  ParallelConfig config;
+  config.n_threads = n_threads;
+  config.tile_height = tile_height;
+  config.backend = backend;
+  config.block_width = block_width;
+  config.parallel_traceback = parallel_traceback;
+  config.length_only = length_only;
+  LongestCommonSubsequenceParallel lcs(view_a, view_b, config);
 
   printf("Starting LCS Parallel Solver\n");
   lcs.solve(); // Compute the LCS using parallel threads
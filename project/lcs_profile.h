@@ -0,0 +1,110 @@
+#ifndef _LCS_PROFILE_H_
+#define _LCS_PROFILE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Performance profile for the parallel LCS engine.
+ *
+ * A profile is a .csv file with one line per calibration run:
+ *
+ *   length,n_threads,tile_height,time
+ *
+ * It is written by `lcs_parallel --autotune` and read back by later runs to
+ * pick the fastest configuration for the size of their input.
+ */
+struct ProfileEntry
+{
+  int length;      // Length of both calibration sequences.
+  int n_threads;   // Number of threads used.
+  int tile_height; // Number of rows per tile.
+  double time;     // Average time taken (in seconds).
+};
+
+void write_profile_csv(const std::string &profile_file_path,
+                       const std::vector<ProfileEntry> &entries)
+{
+  std::ofstream out_file(profile_file_path);
+  if (!out_file.is_open())
+  {
+    std::cerr << "Error writing file: " << profile_file_path << std::endl;
+    exit(1);
+  }
+  out_file << "length,n_threads,tile_height,time\n";
+  for (const ProfileEntry &entry : entries)
+  {
+    out_file << entry.length << "," << entry.n_threads << ","
+             << entry.tile_height << "," << entry.time << "\n";
+  }
+}
+
+void read_profile_csv(const std::string &profile_file_path,
+                      std::vector<ProfileEntry> &entries)
+{
+  std::ifstream in_file(profile_file_path);
+  if (!in_file.is_open())
+  {
+    std::cerr << "Error reading file: " << profile_file_path << std::endl;
+    exit(1);
+  }
+  std::string line;
+  std::getline(in_file, line); // Skip the header.
+  while (std::getline(in_file, line))
+  {
+    if (line.empty())
+    {
+      continue;
+    }
+    std::istringstream fields(line);
+    ProfileEntry entry;
+    char comma;
+    if (!(fields >> entry.length >> comma >> entry.n_threads >> comma >>
+          entry.tile_height >> comma >> entry.time))
+    {
+      std::cerr << "Error: malformed line in profile: " << line << std::endl;
+      exit(1);
+    }
+    entries.push_back(entry);
+  }
+  if (entries.empty())
+  {
+    std::cerr << "Error: profile contains no entries: " << profile_file_path
+              << std::endl;
+    exit(1);
+  }
+}
+
+/* Returns the fastest entry among those calibrated at the length closest
+(on a log scale) to `length`. `entries` must not be empty. */
+ProfileEntry select_profile_entry(const std::vector<ProfileEntry> &entries,
+                                  int length)
+{
+  double log_length = std::log((double)std::max(1, length));
+  int closest_length = entries[0].length;
+  for (const ProfileEntry &entry : entries)
+  {
+    if (std::fabs(std::log((double)entry.length) - log_length) <
+        std::fabs(std::log((double)closest_length) - log_length))
+    {
+      closest_length = entry.length;
+    }
+  }
+
+  const ProfileEntry *best = nullptr;
+  for (const ProfileEntry &entry : entries)
+  {
+    if (entry.length == closest_length && (best == nullptr || entry.time < best->time))
+    {
+      best = &entry;
+    }
+  }
+  return *best;
+}
+
+#endif
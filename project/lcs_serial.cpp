@@ -37,8 +37,8 @@ private:
 
 public:
   // Constructor that initializes the sequences and calls the solve method
-  LongestCommonSubsequenceSerial(const std::string &sequence_a,
-                                 const std::string &sequence_b)
+  LongestCommonSubsequenceSerial(const SequenceView &sequence_a,
+                                 const SequenceView &sequence_b)
       : LongestCommonSubsequence(sequence_a, sequence_b)
   {
     this->solve(); // Solve the LCS for the given sequences
@@ -68,7 +68,9 @@ int main(int argc, char *argv[])
                     {"sequence_b", "Second input sequence.",
                      cxxopts::value<std::string>()->default_value("")}, // Second input sequence
                     {"input_file", "Path to input .csv file.",
-                     cxxopts::value<std::string>()->default_value("")} // Input file.
+                     cxxopts::value<std::string>()->default_value("")}, // Input file.
+                    {"mmap", "Map the input file into memory instead of reading it into strings.",
+                     cxxopts::value<bool>()->default_value("false")} // Memory-mapped input.
                 });
 
   // Parse the command-line options
@@ -78,14 +80,30 @@ int main(int argc, char *argv[])
   std::string sequence_a = command_options["sequence_a"].as<std::string>();
   std::string sequence_b = command_options["sequence_b"].as<std::string>();
   std::string input_file = command_options["input_file"].as<std::string>();
+  bool use_mmap = command_options["mmap"].as<bool>();
 
-  if (input_file != "")
+  /* The solver works on views of the sequences, either of the strings read
+  here or of the mapped file, so they are never copied again. */
+  MappedInput mapped_input;
+  SequenceView view_a, view_b;
+  if (input_file != "" && use_mmap)
   {
-    // Read sequences from .csv file if file path was provided.
-    read_input_csv(input_file, sequence_a, sequence_b);
+    map_input_csv(input_file, mapped_input);
+    view_a = mapped_input.sequence_a;
+    view_b = mapped_input.sequence_b;
+  }
+  else
+  {
+    if (input_file != "")
+    {
+      // Read sequences from .csv file if file path was provided.
+      read_input_csv(input_file, sequence_a, sequence_b);
+    }
+    view_a = SequenceView(sequence_a);
+    view_b = SequenceView(sequence_b);
   }
 
-  if (sequence_a.length() < 1 || sequence_b.length() < 1)
+  if (view_a.length() < 1 || view_b.length() < 1)
   {
     std::cerr << "Error: sequences cannot be empty." << std::endl;
     exit(1);
@@ -95,7 +113,7 @@ int main(int argc, char *argv[])
   printf("-------------------- LCS Serial --------------------\n");
 
   // Create an instance of LongestCommonSubsequenceSerial and solve the LCS
-  LongestCommonSubsequenceSerial lcs(sequence_a, sequence_b);
+  LongestCommonSubsequenceSerial lcs(view_a, view_b);
 
   // Print the length of the LCS and the time taken to compute it
   lcs.printInfo();
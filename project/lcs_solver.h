@@ -0,0 +1,178 @@
+#ifndef _LCS_SOLVER_H_
+#define _LCS_SOLVER_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* Result of solving a single pair of sequences with LCSSolver. */
+struct LCSResult
+{
+  int length = 0;          // Length of the longest common subsequence.
+  std::string subsequence; // The longest common subsequence, if requested.
+};
+
+/**
+ * Reentrant LCS solver for embedding in other programs.
+ *
+ * Unlike the LongestCommonSubsequence classes, a solver is constructed once
+ * and then solves any number of pairs through `solve()`. It performs no I/O,
+ * never exits, and has no global state, so separate solvers can be used from
+ * separate threads at the same time. A single solver must not be shared
+ * between threads.
+ *
+ * The matrix is kept between calls and only grows, so once a solver has seen
+ * its largest input, solving allocates nothing. Passing the same LCSResult to
+ * `solve()` each time reuses its string as well.
+ *
+ * The matrix is computed and traced with the same rules as
+ * LongestCommonSubsequence, so the results are identical.
+ */
+class LCSSolver
+{
+private:
+  /* Scratch matrix of (length_a + 1) x (length_b + 1) entries, stored row by
+  row. Only grows between calls. */
+  std::vector<int> matrix;
+  /* Two rolling rows used when only the length is needed. */
+  std::vector<int> rows;
+
+  void computeMatrix(const std::string &sequence_a, const std::string &sequence_b)
+  {
+    const int height = sequence_a.length() + 1;
+    const int width = sequence_b.length() + 1;
+    if (matrix.size() < (size_t)height * width)
+    {
+      matrix.resize((size_t)height * width);
+    }
+
+    int *scores = matrix.data();
+    std::fill(scores, scores + width, 0); // Top row of 0s.
+    for (int i = 1; i < height; i++)
+    {
+      int *current = scores + (size_t)i * width;
+      const int *top = current - width;
+      const char a = sequence_a[i - 1];
+      current[0] = 0; // Leftmost column of 0s.
+      for (int j = 1; j < width; j++)
+      {
+        if (a == sequence_b[j - 1])
+        {
+          current[j] = top[j - 1] + 1;
+        }
+        else
+        {
+          current[j] = std::max(top[j], current[j - 1]);
+        }
+      }
+    }
+  }
+
+  void traceMatrix(const std::string &sequence_a, const std::string &sequence_b,
+                   std::string &subsequence)
+  {
+    const int width = sequence_b.length() + 1;
+    const int *scores = matrix.data();
+    int i = sequence_a.length();
+    int j = sequence_b.length();
+    int index = scores[(size_t)i * width + j] - 1;
+    subsequence.resize(index + 1);
+    while (index >= 0 && i > 0 && j > 0)
+    {
+      const int *current_row = scores + (size_t)i * width;
+      const int *top_row = current_row - width;
+      int current = current_row[j];
+      int top_left = top_row[j - 1];
+      int top = top_row[j];
+      int left = current_row[j - 1];
+
+      if (top_left == current)
+      {
+        i--;
+        j--;
+      }
+      else if (top_left == top && top_left == left)
+      {
+        subsequence[index] = sequence_a[i - 1];
+        index--;
+        i--;
+        j--;
+      }
+      else if (top == current)
+      {
+        i--;
+      }
+      else
+      {
+        j--;
+      }
+    }
+  }
+
+public:
+  LCSSolver() {}
+
+  /* Solves a pair of sequences into `result`, reusing its storage. If
+  `length_only` is set, the subsequence is left empty and only two rows of
+  scratch space are used. */
+  void solve(const std::string &sequence_a, const std::string &sequence_b,
+             LCSResult &result, bool length_only = false)
+  {
+    if (sequence_a.empty() || sequence_b.empty())
+    {
+      result.length = 0;
+      result.subsequence.clear();
+      return;
+    }
+    if (length_only)
+    {
+      result.length = solveLength(sequence_a, sequence_b);
+      result.subsequence.clear();
+      return;
+    }
+    computeMatrix(sequence_a, sequence_b);
+    traceMatrix(sequence_a, sequence_b, result.subsequence);
+    result.length = result.subsequence.length();
+  }
+
+  LCSResult solve(const std::string &sequence_a, const std::string &sequence_b,
+                  bool length_only = false)
+  {
+    LCSResult result;
+    solve(sequence_a, sequence_b, result, length_only);
+    return result;
+  }
+
+  /* Returns only the length of the longest common subsequence. */
+  int solveLength(const std::string &sequence_a, const std::string &sequence_b)
+  {
+    const int width = sequence_b.length() + 1;
+    if (rows.size() < 2 * (size_t)width)
+    {
+      rows.resize(2 * (size_t)width);
+    }
+    int *top = rows.data();
+    int *current = top + width;
+    std::fill(top, top + width, 0);
+    current[0] = 0;
+    for (size_t i = 1; i <= sequence_a.length(); i++)
+    {
+      const char a = sequence_a[i - 1];
+      for (int j = 1; j < width; j++)
+      {
+        if (a == sequence_b[j - 1])
+        {
+          current[j] = top[j - 1] + 1;
+        }
+        else
+        {
+          current[j] = std::max(top[j], current[j - 1]);
+        }
+      }
+      std::swap(top, current);
+    }
+    return top[width - 1];
+  }
+};
+
+#endif
@@ -0,0 +1,590 @@
+#ifndef _LCS_TRANSPORT_H_
+#define _LCS_TRANSPORT_H_
+
+#include <algorithm> // std::max, std::min
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mpi.h>
+#include <mutex>
+#include <vector>
+
+#include "lcs_boundary.h"
+
+/* Tag used by the default implementations of the collective operations. */
+#define COLLECTIVE_TAG 6
+
+/**
+ * The communication between the processes of the distributed LCS.
+ *
+ * The processes are arranged in a grid of grid_dims[0] rows by grid_dims[1]
+ * columns, numbered row by row (as MPI_Cart_create does without reordering).
+ * Ranks outside of the grid are MPI_PROC_NULL, and MPI_ANY_SOURCE can be
+ * passed to recv(), but an implementation does not otherwise need MPI.
+ *
+ * Messages between a pair of processes with the same tag arrive in the order
+ * they were sent. send() may return before the message has been received.
+ * The collective operations must be called by every process in the same
+ * order; their default implementations only use send() and recv().
+ */
+class Transport
+{
+protected:
+  int grid_dims[2];
+
+  template <typename T>
+  void reduceMaxMessages(const T *in, T *out, const int count, const int root)
+  {
+    if (rank() != root)
+    {
+      send(in, count * sizeof(T), root, COLLECTIVE_TAG);
+      return;
+    }
+    if (out != in)
+    {
+      std::copy(in, in + count, out);
+    }
+    std::vector<T> values(count);
+    for (int source = 0; source < size(); source++)
+    {
+      if (source == root)
+      {
+        continue;
+      }
+      recv(values.data(), count * sizeof(T), source, COLLECTIVE_TAG);
+      for (int i = 0; i < count; i++)
+      {
+        out[i] = std::max(out[i], values[i]);
+      }
+    }
+  }
+
+public:
+  Transport(const int grid_rows, const int grid_cols)
+  {
+    grid_dims[0] = grid_rows;
+    grid_dims[1] = grid_cols;
+  }
+
+  virtual ~Transport() {}
+
+  virtual int rank() = 0;
+  virtual int size() = 0;
+
+  void getGridDims(int dims[2]) const
+  {
+    dims[0] = grid_dims[0];
+    dims[1] = grid_dims[1];
+  }
+
+  void gridCoords(const int rank, int coords[2]) const
+  {
+    coords[0] = rank / grid_dims[1];
+    coords[1] = rank % grid_dims[1];
+  }
+
+  /* Returns MPI_PROC_NULL outside of the grid. */
+  int gridRank(const int row, const int col) const
+  {
+    if (row < 0 || row >= grid_dims[0] || col < 0 || col >= grid_dims[1])
+    {
+      return MPI_PROC_NULL;
+    }
+    return row * grid_dims[1] + col;
+  }
+
+  /* Point-to-point messages. recv() receives at most `bytes` bytes, and
+  returns the rank of the sender. probe() returns whether a message from
+  `source` with `tag` has arrived, without receiving it. */
+  virtual void send(const void *data, int bytes, int dest, int tag) = 0;
+  virtual int recv(void *data, int bytes, int source, int tag) = 0;
+  virtual bool probe(int source, int tag) = 0;
+
+  virtual void barrier()
+  {
+    int token = 0;
+    if (rank() == 0)
+    {
+      for (int source = 1; source < size(); source++)
+      {
+        recv(&token, sizeof(token), source, COLLECTIVE_TAG);
+      }
+      for (int dest = 1; dest < size(); dest++)
+      {
+        send(&token, sizeof(token), dest, COLLECTIVE_TAG);
+      }
+    }
+    else
+    {
+      send(&token, sizeof(token), 0, COLLECTIVE_TAG);
+      recv(&token, sizeof(token), 0, COLLECTIVE_TAG);
+    }
+  }
+
+  virtual void broadcast(void *data, int bytes, int root)
+  {
+    if (rank() != root)
+    {
+      recv(data, bytes, root, COLLECTIVE_TAG);
+      return;
+    }
+    for (int dest = 0; dest < size(); dest++)
+    {
+      if (dest != root)
+      {
+        send(data, bytes, dest, COLLECTIVE_TAG);
+      }
+    }
+  }
+
+  /* Element-wise maximum of `in` over every process into `out` on the root,
+  where `in` and `out` may be the same. `out` is unused on the other
+  processes. */
+  virtual void reduceMax(const int *in, int *out, int count, int root)
+  {
+    reduceMaxMessages(in, out, count, root);
+  }
+
+  virtual void reduceMax(const unsigned char *in, unsigned char *out, int count, int root)
+  {
+    reduceMaxMessages(in, out, count, root);
+  }
+
+  /* Gathers `bytes` bytes from every process into `out` on the root, in
+  rank order. */
+  virtual void gather(const void *in, int bytes, void *out, int root)
+  {
+    std::vector<int> counts(size(), bytes), displs(size());
+    for (int rank = 0; rank < size(); rank++)
+    {
+      displs[rank] = rank * bytes;
+    }
+    gatherv(in, bytes, out, counts.data(), displs.data(), root);
+  }
+
+  /* Gathers `bytes` bytes from every process into `out` on the root, where
+  those of process r go at offset displs[r] and are counts[r] bytes long.
+  `counts` and `displs` are only used on the root. */
+  virtual void gatherv(const void *in, int bytes, void *out, const int *counts,
+                       const int *displs, int root)
+  {
+    if (rank() != root)
+    {
+      send(in, bytes, root, COLLECTIVE_TAG);
+      return;
+    }
+    std::memcpy((char *)out + displs[root], in, bytes);
+    for (int source = 0; source < size(); source++)
+    {
+      if (source != root)
+      {
+        recv((char *)out + displs[source], counts[source], source, COLLECTIVE_TAG);
+      }
+    }
+  }
+
+  /* Creates the links to the neighbors to the left and to the right (either
+  of which may be MPI_PROC_NULL), for messages of up to `capacity` values.
+  Collective; the default links use send() and recv(). */
+  virtual void openBoundaryLinks(int left_rank, int right_rank, int capacity,
+                                 std::unique_ptr<BoundaryLink> &left_link,
+                                 std::unique_ptr<BoundaryLink> &right_link);
+
+  /* Called once the links have been destroyed. Collective. */
+  virtual void closeBoundaryLinks()
+  {
+  }
+
+  /* Stops every process after an unrecoverable error. */
+  virtual void abort(int code) = 0;
+};
+
+/* Boundary link through the point-to-point messages of a transport. */
+class MessageLink : public BoundaryLink
+{
+protected:
+  Transport &transport;
+  int peer;
+  std::vector<int> buffer;
+  int posted_counts[2]; // Values in each message announced by postReceive().
+  int n_posted = 0;
+  int n_received = 0;
+
+public:
+  MessageLink(Transport &transport, int peer, int capacity)
+      : transport(transport), peer(peer), buffer(capacity)
+  {
+  }
+
+  virtual void postReceive(int count) override
+  {
+    posted_counts[n_posted++ % 2] = count;
+  }
+
+  virtual const int *waitReceive() override
+  {
+    transport.recv(buffer.data(), buffer.size() * sizeof(int), peer, BOUNDARY_TAG);
+    traffic.messages_received++;
+    traffic.bytes_received += posted_counts[n_received++ % 2] * sizeof(int);
+    return buffer.data();
+  }
+
+  virtual void releaseReceive() override
+  {
+  }
+
+  virtual int *sendBuffer() override
+  {
+    return buffer.data();
+  }
+
+  virtual void send(int count) override
+  {
+    transport.send(buffer.data(), count * sizeof(int), peer, BOUNDARY_TAG);
+    traffic.messages_sent++;
+    traffic.bytes_sent += count * sizeof(int);
+  }
+
+  virtual void finishSends() override
+  {
+  }
+};
+
+void Transport::openBoundaryLinks(int left_rank, int right_rank, int capacity,
+                                  std::unique_ptr<BoundaryLink> &left_link,
+                                  std::unique_ptr<BoundaryLink> &right_link)
+{
+  if (left_rank != MPI_PROC_NULL)
+  {
+    left_link.reset(new MessageLink(*this, left_rank, capacity));
+  }
+  if (right_rank != MPI_PROC_NULL)
+  {
+    right_link.reset(new MessageLink(*this, right_rank, capacity));
+  }
+}
+
+/**
+ * Transport over an MPI communicator, which must either have no topology or
+ * a 2D Cartesian one created without reordering.
+ *
+ * The boundary links use the given BoundaryTransport. With the shared memory
+ * transport, neighbors on the same node share a window on `node_comm`, and
+ * only neighbors on different nodes exchange messages. With the RMA
+ * transport, every process exposes its receive buffers in `rma_window`.
+ */
+class MPITransport : public Transport
+{
+protected:
+  MPI_Comm comm;
+  const BoundaryTransport boundary_transport;
+  MPI_Comm node_comm = MPI_COMM_NULL;
+  MPI_Win shared_window = MPI_WIN_NULL;
+  MPI_Win rma_window = MPI_WIN_NULL;
+
+  static int commSize(MPI_Comm comm)
+  {
+    int size;
+    MPI_Comm_size(comm, &size);
+    return size;
+  }
+
+  /* Returns the rank in `node_comm` of a neighbor, or MPI_UNDEFINED if it is
+  on another node. */
+  int nodeRank(const int neighbor_rank)
+  {
+    MPI_Group group, node_group;
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_group(node_comm, &node_group);
+    int node_rank;
+    MPI_Group_translate_ranks(group, 1, &neighbor_rank, node_group, &node_rank);
+    MPI_Group_free(&group);
+    MPI_Group_free(&node_group);
+    return node_rank;
+  }
+
+  /* The send buffer to pass to MPI_Reduce(), which only accepts
+  MPI_IN_PLACE on the root. */
+  const void *inPlace(const void *in, const void *out, const int root)
+  {
+    return in == out && rank() == root ? MPI_IN_PLACE : in;
+  }
+
+public:
+  MPITransport(MPI_Comm comm,
+               const BoundaryTransport boundary_transport = BoundaryTransport::TwoSided)
+      : Transport(1, commSize(comm)), comm(comm), boundary_transport(boundary_transport)
+  {
+    int topology;
+    MPI_Topo_test(comm, &topology);
+    if (topology == MPI_CART)
+    {
+      int periods[2], coords[2];
+      MPI_Cart_get(comm, 2, grid_dims, periods, coords);
+    }
+  }
+
+  virtual int rank() override
+  {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+  }
+
+  virtual int size() override
+  {
+    return commSize(comm);
+  }
+
+  virtual void send(const void *data, int bytes, int dest, int tag) override
+  {
+    MPI_Send(data, bytes, MPI_BYTE, dest, tag, comm);
+  }
+
+  virtual int recv(void *data, int bytes, int source, int tag) override
+  {
+    MPI_Status status;
+    MPI_Recv(data, bytes, MPI_BYTE, source, tag, comm, &status);
+    return status.MPI_SOURCE;
+  }
+
+  virtual bool probe(int source, int tag) override
+  {
+    int arrived;
+    MPI_Iprobe(source, tag, comm, &arrived, MPI_STATUS_IGNORE);
+    return arrived;
+  }
+
+  virtual void barrier() override
+  {
+    MPI_Barrier(comm);
+  }
+
+  virtual void broadcast(void *data, int bytes, int root) override
+  {
+    MPI_Bcast(data, bytes, MPI_BYTE, root, comm);
+  }
+
+  virtual void reduceMax(const int *in, int *out, int count, int root) override
+  {
+    MPI_Reduce(inPlace(in, out, root), out, count, MPI_INT, MPI_MAX, root, comm);
+  }
+
+  virtual void reduceMax(const unsigned char *in, unsigned char *out, int count, int root) override
+  {
+    MPI_Reduce(inPlace(in, out, root), out, count, MPI_UNSIGNED_CHAR, MPI_MAX, root, comm);
+  }
+
+  virtual void gather(const void *in, int bytes, void *out, int root) override
+  {
+    MPI_Gather(in, bytes, MPI_BYTE, out, bytes, MPI_BYTE, root, comm);
+  }
+
+  virtual void gatherv(const void *in, int bytes, void *out, const int *counts,
+                       const int *displs, int root) override
+  {
+    MPI_Gatherv(in, bytes, MPI_BYTE, out, counts, displs, MPI_BYTE, root, comm);
+  }
+
+  virtual void openBoundaryLinks(int left_rank, int right_rank, int capacity,
+                                 std::unique_ptr<BoundaryLink> &left_link,
+                                 std::unique_ptr<BoundaryLink> &right_link) override
+  {
+    const int my_rank = rank();
+    int *segment = nullptr;
+    if (boundary_transport == BoundaryTransport::SharedMemory)
+    {
+      /* Each process allocates the segment its left neighbor writes into, and
+      the window stays locked for as long as the links are open. */
+      MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL, &node_comm);
+      MPI_Win_allocate_shared(SharedMemoryLink::segmentSize(capacity) * sizeof(int),
+                              sizeof(int), MPI_INFO_NULL, node_comm, &segment,
+                              &shared_window);
+      std::fill(segment, segment + SharedMemoryLink::segmentSize(capacity), 0);
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, shared_window);
+      MPI_Win_sync(shared_window);
+      MPI_Barrier(node_comm);
+    }
+    else if (boundary_transport == BoundaryTransport::RMA)
+    {
+      MPI_Win_allocate(RMALink::segmentSize(capacity) * sizeof(int), sizeof(int),
+                       MPI_INFO_NULL, comm, &segment, &rma_window);
+      std::fill(segment, segment + RMALink::segmentSize(capacity), 0);
+      MPI_Win_lock_all(0, rma_window);
+      MPI_Win_sync(rma_window);
+      MPI_Barrier(comm);
+    }
+    if (boundary_transport == BoundaryTransport::RMA)
+    {
+      if (left_rank != MPI_PROC_NULL)
+      {
+        left_link.reset(new RMALink(rma_window, segment, my_rank, left_rank, capacity));
+      }
+      if (right_rank != MPI_PROC_NULL)
+      {
+        right_link.reset(new RMALink(rma_window, segment, my_rank, right_rank, capacity));
+      }
+      return;
+    }
+    if (left_rank != MPI_PROC_NULL)
+    {
+      if (node_comm != MPI_COMM_NULL && nodeRank(left_rank) != MPI_UNDEFINED)
+      {
+        left_link.reset(new SharedMemoryLink(shared_window, segment, capacity));
+      }
+      else
+      {
+        left_link.reset(new TwoSidedLink(comm, left_rank, capacity));
+      }
+    }
+    if (right_rank != MPI_PROC_NULL)
+    {
+      int right_node_rank = node_comm != MPI_COMM_NULL ? nodeRank(right_rank) : MPI_UNDEFINED;
+      if (right_node_rank != MPI_UNDEFINED)
+      {
+        MPI_Aint size;
+        int disp_unit;
+        int *right_segment;
+        MPI_Win_shared_query(shared_window, right_node_rank, &size, &disp_unit,
+                             &right_segment);
+        right_link.reset(new SharedMemoryLink(shared_window, right_segment, capacity));
+      }
+      else
+      {
+        right_link.reset(new TwoSidedLink(comm, right_rank, capacity));
+      }
+    }
+  }
+
+  virtual void closeBoundaryLinks() override
+  {
+    if (shared_window != MPI_WIN_NULL)
+    {
+      MPI_Win_unlock_all(shared_window);
+      MPI_Win_free(&shared_window);
+      MPI_Comm_free(&node_comm);
+    }
+    if (rma_window != MPI_WIN_NULL)
+    {
+      MPI_Win_unlock_all(rma_window);
+      MPI_Win_free(&rma_window);
+    }
+  }
+
+  virtual void abort(int code) override
+  {
+    MPI_Abort(MPI_COMM_WORLD, code);
+  }
+};
+
+/**
+ * The mailboxes of a set of simulated ranks, each run by a thread of the
+ * same process. Each rank has its own ThreadTransport onto the world.
+ */
+class ThreadWorld
+{
+public:
+  struct Message
+  {
+    int source;
+    int tag;
+    std::vector<char> data;
+  };
+
+  struct Mailbox
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Message> messages; // In order of arrival.
+  };
+
+  const int n_ranks;
+  const int grid_rows;
+  std::vector<std::unique_ptr<Mailbox>> mailboxes;
+
+  ThreadWorld(const int n_ranks, const int grid_rows)
+      : n_ranks(n_ranks), grid_rows(grid_rows)
+  {
+    for (int rank = 0; rank < n_ranks; rank++)
+    {
+      mailboxes.emplace_back(new Mailbox());
+    }
+  }
+};
+
+/* Transport between the ranks of a ThreadWorld. Messages are copied into the
+mailbox of the receiving rank, so send() never blocks. */
+class ThreadTransport : public Transport
+{
+protected:
+  ThreadWorld &world;
+  const int my_rank;
+
+  /* Returns the first message in `mailbox` matching `source` and `tag`, or
+  the end of the queue. The caller must hold the mailbox's lock. */
+  static std::deque<ThreadWorld::Message>::iterator find(ThreadWorld::Mailbox &mailbox,
+                                                         int source, int tag)
+  {
+    return std::find_if(mailbox.messages.begin(), mailbox.messages.end(),
+                        [source, tag](const ThreadWorld::Message &message)
+                        { return message.tag == tag &&
+                                 (source == MPI_ANY_SOURCE || message.source == source); });
+  }
+
+public:
+  ThreadTransport(ThreadWorld &world, const int rank)
+      : Transport(world.grid_rows, world.n_ranks / world.grid_rows),
+        world(world), my_rank(rank)
+  {
+  }
+
+  virtual int rank() override
+  {
+    return my_rank;
+  }
+
+  virtual int size() override
+  {
+    return world.n_ranks;
+  }
+
+  virtual void send(const void *data, int bytes, int dest, int tag) override
+  {
+    ThreadWorld::Mailbox &mailbox = *world.mailboxes[dest];
+    {
+      std::lock_guard<std::mutex> lock(mailbox.mutex);
+      const char *begin = (const char *)data;
+      mailbox.messages.push_back({my_rank, tag, std::vector<char>(begin, begin + bytes)});
+    }
+    mailbox.cv.notify_all();
+  }
+
+  virtual int recv(void *data, int bytes, int source, int tag) override
+  {
+    ThreadWorld::Mailbox &mailbox = *world.mailboxes[my_rank];
+    std::unique_lock<std::mutex> ulock(mailbox.mutex);
+    auto message = mailbox.messages.end();
+    mailbox.cv.wait(ulock, [&]
+                    { return (message = find(mailbox, source, tag)) != mailbox.messages.end(); });
+    std::memcpy(data, message->data.data(), std::min(bytes, (int)message->data.size()));
+    int sender = message->source;
+    mailbox.messages.erase(message);
+    return sender;
+  }
+
+  virtual bool probe(int source, int tag) override
+  {
+    ThreadWorld::Mailbox &mailbox = *world.mailboxes[my_rank];
+    std::lock_guard<std::mutex> lock(mailbox.mutex);
+    return find(mailbox, source, tag) != mailbox.messages.end();
+  }
+
+  virtual void abort(int code) override
+  {
+    exit(code);
+  }
+};
+
+#endif